@@ -14,7 +14,6 @@ public class MVAWS : ModuleRules {
 		// Wanna try C++ 17 std
 		CppStandard = CppStandardVersion.Cpp17;
 		PrivateDefinitions.Add("_SILENCE_CXX17_OLD_ALLOCATOR_MEMBERS_DEPRECATION_WARNING");
-		PrivateDefinitions.Add("_SILENCE_CXX17_STRSTREAM_DEPRECATION_WARNING");
 
 		PublicDependencyModuleNames.AddRange(new string[] {
             "Core",
@@ -27,7 +26,8 @@ public class MVAWS : ModuleRules {
 
         PrivateDependencyModuleNames.AddRange(new string[] { 
 			"AWSSDK",
-			"HTTP"
+			"HTTP",
+			"Sockets"
 		});
     }
 }
@@ -30,20 +30,55 @@ using namespace Aws::CloudWatchLogs::Model;
 using Aws::CloudWatchLogs::CloudWatchLogsError;
 using Aws::CloudWatchLogs::CloudWatchLogsErrors;
 
+namespace {
 
-FCloudWatchLogOutputDevice::FCloudWatchLogOutputDevice(const FString &n_log_group_prefix)
+// PutLogEvents limits, see https://docs.aws.amazon.com/AmazonCloudWatchLogs/latest/APIReference/API_PutLogEvents.html
+constexpr int32     s_max_batch_events = 10000;
+constexpr uint64    s_max_batch_bytes = 1048576;
+constexpr uint64    s_event_overhead = 26;
+constexpr uint64    s_max_event_bytes = 262144 - s_event_overhead;
+constexpr long long s_max_batch_span = 24ll * 60 * 60 * 1000;
+
+// Longer messages are cut before they go into the buffer. Converted to UTF-8
+// they may still be too long, so they are cut again when formatting
+constexpr int32     s_max_message_chars = s_max_event_bytes / sizeof(TCHAR);
+
+// A log stream takes no more than 5 requests per second. I stay below that and
+// don't send more than this many batches in one go so teardown isn't held up
+constexpr int32     s_max_batches_per_tick = 5;
+constexpr float     s_batch_interval = 0.2f;
+
+constexpr double    s_send_interval = 5.0;
+
+// With a spool, lines go to disk this often
+constexpr double    s_spool_interval = 1.0;
+
+// Wait this long before trying to create log group and stream again
+constexpr double    s_setup_retry_interval = 30.0;
+}
+
+
+FCloudWatchLogOutputDevice::FCloudWatchLogOutputDevice(const FCloudWatchLogSettings &n_settings)
 		: m_logger_interrupted{ false }
-		, m_log_group_prefix(n_log_group_prefix)
-		, m_log_group_name{ TCHAR_TO_UTF8(*n_log_group_prefix) }
+		, m_buffer{ n_settings.m_buffer_bytes, n_settings.m_overflow_policy }
+		, m_spool_directory{ n_settings.m_spool_directory }
+		, m_spool_segment_bytes{ n_settings.m_spool_segment_bytes }
+		, m_spool_max_bytes{ n_settings.m_spool_max_bytes }
+		, m_log_group_prefix(n_settings.m_log_group_prefix)
+		, m_log_group_name{ TCHAR_TO_UTF8(*n_settings.m_log_group_prefix) }
 {
 	m_log_group_name.append("unspecified");
 	bAutoEmitLineTerminator = false;
+	m_wake = FPlatformProcess::GetSynchEventFromPool(false);
 	m_logger_thread = MakeUnique<FThread>(TEXT("AWS_Logging"), [this] { this->log_thread(); });
 }
 
 FCloudWatchLogOutputDevice::~FCloudWatchLogOutputDevice() noexcept
 {
 	TearDown();
+
+	FPlatformProcess::ReturnSynchEventToPool(m_wake);
+	m_wake = nullptr;
 }
 
 void FCloudWatchLogOutputDevice::TearDown()
@@ -53,11 +88,14 @@ void FCloudWatchLogOutputDevice::TearDown()
 	{
 		// UE_LOG(LogMVAWS, Display, TEXT("Shutting down logging thread"));
 		m_logger_interrupted.Store(true);
+		m_wake->Trigger();
 		m_logger_thread->Join();
 		m_logger_thread.Reset();
 
 		Aws::Delete(m_cwl);
 		m_cwl = nullptr;
+
+		m_spool.Reset();
 	}
 }
 
@@ -68,43 +106,28 @@ void FCloudWatchLogOutputDevice::Serialize(const TCHAR *n_message, ELogVerbosity
 
 void FCloudWatchLogOutputDevice::Serialize(const TCHAR* n_message, ELogVerbosity::Type n_verbosity, const FName &n_category)
 {
-	FCloudWatchLogOutputDevice::entry e;
-	e.m_timestamp = epoch_milliseconds();
-	e.m_message.reserve(128);
+	// This may run on the game thread. So I only copy the raw line into the buffer
+	// here and leave formatting and conversion to the logger thread
+	const int32 length = FMath::Min(FCString::Strlen(n_message), s_max_message_chars);
+
+	FLogRecordHeader header;
+	header.m_timestamp = epoch_milliseconds();
+	header.m_size = static_cast<uint32>(length * sizeof(TCHAR));
+	header.m_category = n_category.GetDisplayIndex().ToUnstableInt();
+	header.m_category_number = n_category.GetNumber();
+	header.m_verbosity = static_cast<uint8>(n_verbosity & ELogVerbosity::VerbosityMask);
 
-	switch (n_verbosity)
+	// This is thread safe.
+	if (!m_buffer.push(header, n_message))
 	{
-		case ELogVerbosity::NoLogging:
-			e.m_message = Aws::String("[NOLOGGING] (");
-			break;
-		case ELogVerbosity::Fatal:
-			e.m_message = Aws::String("[FATAL] (");
-			break;
-		case ELogVerbosity::Error:
-			e.m_message = Aws::String("[ERROR] (");
-			break;
-		case ELogVerbosity::Warning:
-			e.m_message = Aws::String("[WARNING] (");
-			break;
-		case ELogVerbosity::Display:
-			e.m_message = Aws::String("[INFO] (");
-			break;
-		case ELogVerbosity::Log:
-			e.m_message = Aws::String("[LOG] (");
-			break;
-		case ELogVerbosity::Verbose:
-			e.m_message = Aws::String("[VERBOSE] (");
-			break;
-		default:
-			e.m_message = Aws::String("[CATCH_ALL] (");
+		return;
 	}
 
-	e.m_message.append(TCHAR_TO_UTF8(*n_category.ToString()));
-	e.m_message.append(") ");
-	e.m_message.append(TCHAR_TO_UTF8(n_message));
-
-	// This is thread safe.
-	m_log_q.Enqueue(MoveTemp(e));
+	// Don't wait for the next tick when there's enough for a full request
+	if (m_buffer.used_bytes() >= s_max_batch_bytes && !m_flush_requested.Exchange(true))
+	{
+		m_wake->Trigger();
+	}
 }
 
 FString FCloudWatchLogOutputDevice::get_log_group_name() noexcept
@@ -144,6 +167,75 @@ void FCloudWatchLogOutputDevice::log_thread() noexcept
 	}
 	m_cwl = Aws::New<Aws::CloudWatchLogs::CloudWatchLogsClient>("cloudwatchlogs", client_config);
 
+	if (!m_spool_directory.IsEmpty())
+	{
+		m_spool = MakeUnique<FLogSpool>(m_spool_directory, m_spool_segment_bytes, m_spool_max_bytes);
+		if (!m_spool->open())
+		{
+			UE_LOG(LogMVAWS, Error, TEXT("Cannot spool CloudWatch logs to '%s', keeping them in memory"), *m_spool_directory);
+			m_spool.Reset();
+		}
+	}
+
+	// Until log group and stream exist, lines wait in the buffer or spool
+	bool stream_ready = false;
+	double next_setup = 0.0;
+	double next_send = FPlatformTime::Seconds() + s_send_interval;
+
+	while (!m_logger_interrupted)
+	{
+		// CloudWatch requests cost serious money. So I opt for a longer logging delay
+		// here in order to not send too often. If you require more timely logs at 
+		// the expense of CW costs, feel free to reduce to, say 3 or 1.
+		// Serialize() and TearDown() wake me up earlier. With a spool, I wake up
+		// more often to get lines to disk but still send at the same pace
+		m_wake->Wait(FTimespan::FromSeconds(m_spool ? s_spool_interval : s_send_interval));
+		const bool flush_requested = m_flush_requested.Exchange(false);
+
+		if (m_logger_interrupted)
+		{
+			// What's on disk is sent after the next start
+			if (m_spool)
+			{
+				spool_lines();
+			}
+			return;
+		}
+
+		report_dropped_lines();
+		if (m_spool)
+		{
+			spool_lines();
+		}
+
+		const double now = FPlatformTime::Seconds();
+		if (!stream_ready)
+		{
+			if (now < next_setup)
+			{
+				continue;
+			}
+
+			stream_ready = create_log_stream();
+			if (!stream_ready)
+			{
+				next_setup = now + s_setup_retry_interval;
+				continue;
+			}
+		}
+
+		if (m_spool && now < next_send && !flush_requested && !m_backlog)
+		{
+			continue;
+		}
+
+		next_send = now + s_send_interval;
+		send_log_messages();
+	}
+}
+
+bool FCloudWatchLogOutputDevice::create_log_stream() noexcept
+{
 	// Now we should have all the data to create a log group and stream for us
 	CreateLogGroupRequest clgr;
 	clgr.SetLogGroupName(m_log_group_name);
@@ -154,7 +246,7 @@ void FCloudWatchLogOutputDevice::log_thread() noexcept
 		if (err.GetErrorType() != CloudWatchLogsErrors::RESOURCE_ALREADY_EXISTS)
 		{
 			UE_LOG(LogMVAWS, Error, TEXT("Failed to create cloudwatch log group: %s"), UTF8_TO_TCHAR(err.GetMessage().c_str()));
-			return;
+			return false;
 		}
 	}
 
@@ -164,71 +256,275 @@ void FCloudWatchLogOutputDevice::log_thread() noexcept
 	CreateLogStreamOutcome oc = m_cwl->CreateLogStream(clsr);
 	if (!oc.IsSuccess())
 	{
-		UE_LOG(LogMVAWS, Error, TEXT("Failed to create cloudwatch log stream: %s"), UTF8_TO_TCHAR(oc.GetError().GetMessage().c_str()));
-		return;
+		// It may have been created by an earlier attempt
+		if (oc.GetError().GetErrorType() != CloudWatchLogsErrors::RESOURCE_ALREADY_EXISTS)
+		{
+			UE_LOG(LogMVAWS, Error, TEXT("Failed to create cloudwatch log stream: %s"), UTF8_TO_TCHAR(oc.GetError().GetMessage().c_str()));
+			return false;
+		}
 	}
 
-	while (!m_logger_interrupted)
+	return true;
+}
+
+void FCloudWatchLogOutputDevice::spool_lines() noexcept
+{
+	FLogRecordHeader header;
+	Aws::String line;
+	while (m_buffer.pop(header, m_payload))
 	{
-		// CloudWatch requests cost serious money. So I opt for a longer logging delay
-		// here in order to not send too often. If you require more timely logs at 
-		// the expense of CW costs, feel free to reduce to, say 3 or 1
-		unsigned int sleep_time = 5;
-		while (sleep_time--)
+		format_line(header, m_payload, line);
+		if (!m_spool->append(header.m_timestamp, line.data(), static_cast<uint32>(line.size())))
 		{
-			if (m_logger_interrupted)
-			{
-				return;
-			}
-			else
+			// This line is lost. The others stay in the buffer until the next attempt
+			if (!m_spool_failing)
 			{
-				FPlatformProcess::Sleep(1.0);
+				m_spool_failing = true;
+				UE_LOG(LogMVAWS, Error, TEXT("Failed to write CloudWatch log spool in '%s'"), *m_spool_directory);
 			}
+			return;
 		}
 
-		if (!m_log_q.IsEmpty())
+		m_spool_failing = false;
+	}
+}
+
+const Aws::String &FCloudWatchLogOutputDevice::category_name(const FLogRecordHeader &n_header) noexcept
+{
+	const uint64 key = (static_cast<uint64>(n_header.m_category) << 32) | static_cast<uint32>(n_header.m_category_number);
+	if (const Aws::String *name = m_category_names.Find(key))
+	{
+		return *name;
+	}
+
+	const FName category = FName::CreateFromDisplayId(FNameEntryId::FromUnstableInt(n_header.m_category), n_header.m_category_number);
+	return m_category_names.Add(key, Aws::String{ TCHAR_TO_UTF8(*category.ToString()) });
+}
+
+void FCloudWatchLogOutputDevice::format_line(const FLogRecordHeader &n_header, const TArray<uint8> &n_payload, Aws::String &n_message) noexcept
+{
+	switch (n_header.m_verbosity)
+	{
+		case ELogVerbosity::NoLogging:
+			n_message = "[NOLOGGING] (";
+			break;
+		case ELogVerbosity::Fatal:
+			n_message = "[FATAL] (";
+			break;
+		case ELogVerbosity::Error:
+			n_message = "[ERROR] (";
+			break;
+		case ELogVerbosity::Warning:
+			n_message = "[WARNING] (";
+			break;
+		case ELogVerbosity::Display:
+			n_message = "[INFO] (";
+			break;
+		case ELogVerbosity::Log:
+			n_message = "[LOG] (";
+			break;
+		case ELogVerbosity::Verbose:
+			n_message = "[VERBOSE] (";
+			break;
+		default:
+			n_message = "[CATCH_ALL] (";
+	}
+
+	n_message.append(category_name(n_header));
+	n_message.append(") ");
+
+	const int32 length = static_cast<int32>(n_header.m_size / sizeof(TCHAR));
+	const size_t prefix = n_message.size();
+	n_message.resize(prefix + 3 * static_cast<size_t>(length));
+	const int32 written = utf16_to_utf8(reinterpret_cast<const TCHAR *>(n_payload.GetData()), length, &n_message[prefix]);
+	n_message.resize(prefix + written);
+
+	// Overly long messages are cut, at a UTF-8 character boundary
+	if (n_message.size() > s_max_event_bytes)
+	{
+		size_t cut = s_max_event_bytes;
+		while (cut && (static_cast<unsigned char>(n_message[cut]) & 0xC0) == 0x80)
 		{
-			send_log_messages();
+			--cut;
 		}
+		n_message.resize(cut);
 	}
 }
 
-void FCloudWatchLogOutputDevice::send_log_messages() noexcept
+void FCloudWatchLogOutputDevice::report_dropped_lines() noexcept
 {
-	int max_log_events = 50;
+	const uint64 dropped = m_buffer.dropped_lines();
+	if (dropped == m_dropped_reported)
+	{
+		return;
+	}
+
+	const uint64 lines = dropped - m_dropped_reported;
+	m_dropped_reported = dropped;
 
-	PutLogEventsRequest request;
-	if (!m_upload_sequence_token.empty())
+	// This one goes into the buffer too. Warning so it survives DropBelowWarning
+	UE_LOG(LogMVAWS, Warning, TEXT("CloudWatch log buffer overflow, %llu lines dropped"), lines);
+	IMVAWSModule::Get().count_log_lines_dropped(static_cast<uint32>(FMath::Min<uint64>(lines, MAX_uint32)));
+}
+
+bool FCloudWatchLogOutputDevice::next_entry(entry &n_entry) noexcept
+{
+	if (m_spool)
 	{
-		request.SetSequenceToken(m_upload_sequence_token);
+		int64 timestamp = 0;
+		if (!m_spool->read(timestamp, n_entry.m_message))
+		{
+			return false;
+		}
+
+		n_entry.m_timestamp = timestamp;
+		return true;
 	}
-	request.SetLogGroupName(m_log_group_name);
-	request.SetLogStreamName(m_log_stream_name);
 
-	// One by one, pop log entries from the q and add them to the CloudWatch
-	// request. Not more than 50 to not overload the body of the request.
-	FCloudWatchLogOutputDevice::entry le;
+	if (m_carry.IsSet())
+	{
+		n_entry = MoveTemp(m_carry.GetValue());
+		m_carry.Reset();
+		return true;
+	}
 
-	while (m_log_q.Dequeue(le) && max_log_events--)
+	FLogRecordHeader header;
+	if (!m_buffer.pop(header, m_payload))
 	{
-		InputLogEvent ile;
-		ile.SetTimestamp(le.m_timestamp);
-		ile.SetMessage(le.m_message);
-		request.AddLogEvents(std::move(ile));
+		return false;
 	}
 
-	// Send the logs to CloudWatch. They should appear in the AWS console a
-	// few seconds later
-	PutLogEventsOutcome oc = m_cwl->PutLogEvents(request);
+	n_entry.m_timestamp = header.m_timestamp;
+	format_line(header, m_payload, n_entry.m_message);
+	return true;
+}
 
-	if (oc.IsSuccess())
+void FCloudWatchLogOutputDevice::put_back(entry &&n_entry) noexcept
+{
+	if (m_spool)
 	{
-		m_upload_sequence_token = oc.GetResult().GetNextSequenceToken();
+		m_spool->unread();
 	}
 	else
 	{
-		const CloudWatchLogsError &err{ oc.GetError() };
-		UE_LOG(LogMVAWS, Error, TEXT("Failed to send CloudWatch Logs: %s"), UTF8_TO_TCHAR(err.GetMessage().c_str()));
+		m_carry.Emplace(MoveTemp(n_entry));
+	}
+}
+
+bool FCloudWatchLogOutputDevice::fill_batch(TArray<entry> &n_batch) noexcept
+{
+	uint64 batch_bytes = 0;
+	long long first = 0;
+	long long last = 0;
+
+	while (n_batch.Num() < s_max_batch_events)
+	{
+		entry e;
+		if (!next_entry(e))
+		{
+			break;
+		}
+
+		const uint64 size = e.m_message.size() + s_event_overhead;
+		if (!n_batch.IsEmpty())
+		{
+			const long long span = FMath::Max(last, e.m_timestamp) - FMath::Min(first, e.m_timestamp);
+			if (batch_bytes + size > s_max_batch_bytes || span > s_max_batch_span)
+			{
+				// goes into the next one
+				put_back(MoveTemp(e));
+				break;
+			}
+
+			first = FMath::Min(first, e.m_timestamp);
+			last = FMath::Max(last, e.m_timestamp);
+		}
+		else
+		{
+			first = last = e.m_timestamp;
+		}
+
+		batch_bytes += size;
+		n_batch.Add(MoveTemp(e));
+	}
+
+	return !n_batch.IsEmpty();
+}
+
+void FCloudWatchLogOutputDevice::send_log_messages() noexcept
+{
+	TArray<entry> batch;
+	m_backlog = false;
+
+	for (int32 i = 0; i < s_max_batches_per_tick && !m_logger_interrupted; ++i)
+	{
+		batch.Reset();
+		if (!fill_batch(batch))
+		{
+			return;
+		}
+
+		if (i)
+		{
+			FPlatformProcess::Sleep(s_batch_interval);
+		}
+
+		// Lines logged by several threads may come out of the queue slightly out of order.
+		// CloudWatch insists on chronological order within a request
+		batch.StableSort([](const entry &n_lhs, const entry &n_rhs) {
+				return n_lhs.m_timestamp < n_rhs.m_timestamp;
+			});
+
+		PutLogEventsRequest request;
+		if (!m_upload_sequence_token.empty())
+		{
+			request.SetSequenceToken(m_upload_sequence_token);
+		}
+		request.SetLogGroupName(m_log_group_name);
+		request.SetLogStreamName(m_log_stream_name);
+
+		Aws::Vector<InputLogEvent> events;
+		events.reserve(batch.Num());
+		for (entry &e : batch)
+		{
+			InputLogEvent ile;
+			ile.SetTimestamp(e.m_timestamp);
+			ile.SetMessage(std::move(e.m_message));
+			events.push_back(std::move(ile));
+		}
+		request.SetLogEvents(std::move(events));
+
+		// Send the logs to CloudWatch. They should appear in the AWS console a
+		// few seconds later
+		PutLogEventsOutcome oc = m_cwl->PutLogEvents(request);
+
+		if (oc.IsSuccess())
+		{
+			m_upload_sequence_token = oc.GetResult().GetNextSequenceToken();
+			if (m_spool)
+			{
+				m_spool->commit();
+			}
+		}
+		else
+		{
+			const CloudWatchLogsError &err{ oc.GetError() };
+			UE_LOG(LogMVAWS, Error, TEXT("Failed to send %i CloudWatch Logs: %s"), batch.Num(), UTF8_TO_TCHAR(err.GetMessage().c_str()));
+
+			// Spooled lines are sent again with the next tick
+			if (m_spool)
+			{
+				m_spool->rewind();
+			}
+			return;
+		}
+	}
+
+	// Budget used up, carry on right away with the next tick
+	if (m_spool ? m_spool->has_unread() : (!m_buffer.is_empty() || m_carry.IsSet()))
+	{
+		m_backlog = true;
+		m_wake->Trigger();
 	}
 }
 
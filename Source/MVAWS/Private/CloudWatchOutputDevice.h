@@ -9,7 +9,10 @@
 #include "Templates/Atomic.h"
 #include "Logging/LogVerbosity.h"
 #include "Misc/OutputDevice.h"
-#include "Containers/Queue.h"
+#include "LogRingBuffer.h"
+#include "LogSpool.h"
+#include "HAL/Event.h"
+#include "Misc/Optional.h"
 
 #include "Windows/PreWindowsApi.h"
 #include <aws/core/Aws.h>
@@ -24,13 +27,37 @@ namespace Aws
 	}
 }
 
+/*!
+ * Config of the CloudWatch log output device
+ */
+struct FCloudWatchLogSettings
+{
+	FString             m_log_group_prefix;
+
+	/// how much memory lines waiting to be sent may occupy
+	uint64              m_buffer_bytes = 16 * 1024 * 1024;
+
+	/// which lines to drop when that is exhausted
+	ELogOverflowPolicy  m_overflow_policy = ELogOverflowPolicy::DropOldest;
+
+	/// spool lines to this directory before sending. Empty to keep them in memory only
+	FString             m_spool_directory;
+	uint64              m_spool_segment_bytes = 16 * 1024 * 1024;
+	uint64              m_spool_max_bytes = 1024 * 1024 * 1024;
+};
+
 /*! \brief logging backend to be included in Unreal's logs
- *  sends logs to CloudWatch every 5 seconds
+ *  sends logs to CloudWatch every 5 seconds, or earlier when a full request
+ *  worth of log lines has piled up.
+ *  Lines wait in a buffer of fixed size. When CloudWatch can't keep up, lines are
+ *  dropped according to the overflow policy and I report how many.
+ *  With a spool directory, lines go to disk every second and are sent from there,
+ *  so they survive crashes and CloudWatch being unreachable.
  */
 class FCloudWatchLogOutputDevice : public FOutputDevice {
 
 	public:
-		FCloudWatchLogOutputDevice(const FString &n_log_group_prefix);
+		FCloudWatchLogOutputDevice(const FCloudWatchLogSettings &n_settings);
 		virtual ~FCloudWatchLogOutputDevice() noexcept;
 
 		void TearDown() override;
@@ -45,9 +72,41 @@ class FCloudWatchLogOutputDevice : public FOutputDevice {
 		/// loop and log
 		void log_thread() noexcept;
 
-		/// called from thread
+		/// called from thread. Sends batches until the queue is empty or the tick's budget is used up
 		void send_log_messages() noexcept;
 
+		/// create log group and stream. Returns false if that failed and should be retried later
+		bool create_log_stream() noexcept;
+
+		/// move lines from the buffer to the spool
+		void spool_lines() noexcept;
+
+		struct entry {
+			long long            m_timestamp;   //!< millis since epoch (type required by InputLogEvent)
+			Aws::String          m_message;
+		};
+
+		/// turn a line from the buffer into what is sent, in UTF-8
+		void format_line(const FLogRecordHeader &n_header, const TArray<uint8> &n_payload, Aws::String &n_message) noexcept;
+
+		/// UTF-8 name of a category, cached as there are few of them
+		const Aws::String &category_name(const FLogRecordHeader &n_header) noexcept;
+
+		/// log and count lines dropped since the last call
+		void report_dropped_lines() noexcept;
+
+		/// next line to be sent, from the spool if there is one, else from the buffer
+		bool next_entry(entry &n_entry) noexcept;
+
+		/// give back a line next_entry() returned, so it comes first next time
+		void put_back(entry &&n_entry) noexcept;
+
+		/*!
+		 * Take as many entries from the buffer as fit into one PutLogEvents request.
+		 * \return false if there was nothing to take
+		 */
+		bool fill_batch(TArray<entry> &n_batch) noexcept;
+
 		// Determine a suitable log group name by using the environment 
 		// variable MVAWS_STACK_NAME and assemble something.
 		FString get_log_group_name() noexcept;
@@ -65,14 +124,37 @@ class FCloudWatchLogOutputDevice : public FOutputDevice {
 		TUniquePtr<FThread>      m_logger_thread;
 		TAtomic<bool>            m_logger_interrupted;
 
-		struct entry {
-			long long            m_timestamp;   //!< millis since epoch (type required by InputLogEvent)
-			Aws::String          m_message;
-		};
+		/// wakes the logger thread before its tick is due
+		FEvent                  *m_wake = nullptr;
+
+		/// set when a line pushed the buffer over one request's worth, reset by thread
+		TAtomic<bool>            m_flush_requested{ false };
+
+		FLogRingBuffer           m_buffer;
+
+		/// what report_dropped_lines() has reported already. Only accessed by thread
+		uint64                   m_dropped_reported = 0;
+
+		/// payload of the last line taken from the buffer. Only accessed by thread
+		TArray<uint8>            m_payload;
+
+		/// category names by display index and number. Only accessed by thread
+		TMap<uint64, Aws::String> m_category_names;
+
+		/// an entry that didn't fit into the last batch. Only accessed by thread
+		TOptional<entry>         m_carry;
+
+		/// set when the last send left lines behind. Only accessed by thread
+		bool                     m_backlog = false;
 
-		using LogQueue = TQueue<entry, EQueueMode::Mpsc>;
+		/// Created by thread when configured and the directory is usable
+		TUniquePtr<FLogSpool>    m_spool;
+		const FString            m_spool_directory;
+		const uint64             m_spool_segment_bytes;
+		const uint64             m_spool_max_bytes;
 
-		LogQueue                 m_log_q;
+		/// so a failing spool doesn't flood the log. Only accessed by thread
+		bool                     m_spool_failing = false;
 		FString                  m_instance_id;
 		const FString            m_log_group_prefix;
 		Aws::String              m_log_group_name;
@@ -0,0 +1,60 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#include "LogLinearHistogram.h"
+
+double FLogLinearHistogram::bucket_value(const int32 n_index) noexcept
+{
+	if (n_index < static_cast<int32>(s_sub_bucket_count))
+	{
+		return static_cast<double>(n_index);
+	}
+
+	const uint32 shift = (n_index - s_sub_bucket_count) / s_sub_bucket_count;
+	const uint32 sub_bucket = (n_index - s_sub_bucket_count) % s_sub_bucket_count;
+
+	const uint64 lower = static_cast<uint64>(s_sub_bucket_count + sub_bucket) << shift;
+	const uint64 width = uint64{ 1 } << shift;
+
+	return static_cast<double>(lower) + static_cast<double>(width - 1) / 2.0;
+}
+
+void FLogLinearHistogram::merge(const FLogLinearHistogram &n_other) noexcept
+{
+	for (int32 i = 0; i < s_bucket_count; ++i)
+	{
+		m_counts[i] += n_other.m_counts[i];
+	}
+
+	m_total_count += n_other.m_total_count;
+}
+
+void FLogLinearHistogram::reset() noexcept
+{
+	FMemory::Memzero(m_counts);
+	m_total_count = 0;
+}
+
+double FLogLinearHistogram::value_at_quantile(const double n_quantile) const noexcept
+{
+	if (!m_total_count)
+	{
+		return 0.0;
+	}
+
+	// rank of the sample we are looking for, 1-based
+	const uint64 rank = FMath::Max<uint64>(1, static_cast<uint64>(FMath::CeilToDouble(FMath::Clamp(n_quantile, 0.0, 1.0) * m_total_count)));
+
+	uint64 seen = 0;
+	for (int32 i = 0; i < s_bucket_count; ++i)
+	{
+		seen += m_counts[i];
+		if (seen >= rank)
+		{
+			return bucket_value(i);
+		}
+	}
+
+	return bucket_value(s_bucket_count - 1);
+}
@@ -0,0 +1,78 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#pragma once
+
+#include "CoreMinimal.h"
+
+/*!
+ * A fixed size histogram with log-linear buckets, like HdrHistogram.
+ *
+ * Values below 16 get a bucket each. Above, every power of two is split into
+ * 16 equally wide buckets, so a bucket is never wider than 1/16th of its lower
+ * bound and any value is represented within ~3%. Values up to 2^37 are covered,
+ * larger ones end up in the last bucket.
+ *
+ * Bucket boundaries are the same for every instance, so histograms can be merged
+ * by adding up counts. Adding values never allocates.
+ */
+class FLogLinearHistogram
+{
+	public:
+		static constexpr uint32 s_sub_bucket_bits = 4;
+		static constexpr uint32 s_sub_bucket_count = 1u << s_sub_bucket_bits;
+		static constexpr uint32 s_max_exponent = 36;
+		static constexpr int32  s_bucket_count = s_sub_bucket_count + (s_max_exponent - s_sub_bucket_bits + 1) * s_sub_bucket_count;
+
+		/// which bucket n_value falls into
+		static int32 bucket_index(const uint64 n_value) noexcept
+		{
+			if (n_value < s_sub_bucket_count)
+			{
+				return static_cast<int32>(n_value);
+			}
+
+			const uint32 exponent = FMath::FloorLog2_64(n_value);
+			if (exponent > s_max_exponent)
+			{
+				return s_bucket_count - 1;
+			}
+
+			const uint32 shift = exponent - s_sub_bucket_bits;
+			const uint32 sub_bucket = static_cast<uint32>(n_value >> shift) - s_sub_bucket_count;
+			return static_cast<int32>(s_sub_bucket_count + shift * s_sub_bucket_count + sub_bucket);
+		}
+
+		/// the value in the middle of bucket n_index, which all its samples are reported as
+		static double bucket_value(const int32 n_index) noexcept;
+
+		void add(const uint64 n_value, const uint64 n_count = 1) noexcept
+		{
+			add_to_bucket(bucket_index(n_value), n_count);
+		}
+
+		void add_to_bucket(const int32 n_index, const uint64 n_count) noexcept
+		{
+			m_counts[n_index] += n_count;
+			m_total_count += n_count;
+		}
+
+		/// add all of n_other's samples to this one
+		void merge(const FLogLinearHistogram &n_other) noexcept;
+
+		void reset() noexcept;
+
+		uint64 total_count() const noexcept { return m_total_count; }
+		uint64 count_at(const int32 n_index) const noexcept { return m_counts[n_index]; }
+
+		/*!
+		 * \param n_quantile between 0 and 1, e.g. 0.95 for p95
+		 * \return bucket value which n_quantile of samples are at or below, 0 if empty
+		 */
+		double value_at_quantile(const double n_quantile) const noexcept;
+
+	private:
+		uint64 m_counts[s_bucket_count] = {};
+		uint64 m_total_count = 0;
+};
@@ -0,0 +1,166 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#include "LogRingBuffer.h"
+
+#include "Misc/ScopeLock.h"
+
+#include <cstring>
+
+namespace {
+
+constexpr uint64 s_alignment = alignof(FLogRecordHeader);
+constexpr uint64 s_header_size = sizeof(FLogRecordHeader);
+
+// A header with this size tells the reader to continue at the start of the buffer
+constexpr uint32 s_wrap_marker = MAX_uint32;
+
+// Don't allow silly small buffers
+constexpr uint64 s_min_capacity = 64 * 1024;
+}
+
+FLogRingBuffer::FLogRingBuffer(const uint64 n_capacity, const ELogOverflowPolicy n_policy)
+		: m_capacity{ Align(FMath::Max(n_capacity, s_min_capacity), s_alignment) }
+		, m_policy{ n_policy }
+		, m_data{ MakeUnique<uint8[]>(m_capacity) }
+{
+}
+
+uint64 FLogRingBuffer::record_size(const uint32 n_size) noexcept
+{
+	return Align(s_header_size + n_size, s_alignment);
+}
+
+bool FLogRingBuffer::push(const FLogRecordHeader &n_header, const void *n_payload) noexcept
+{
+	const uint64 size = record_size(n_header.m_size);
+	if (size > m_capacity)
+	{
+		m_dropped.IncrementExchange();
+		return false;
+	}
+
+	FScopeLock lock(&m_lock);
+
+	if (m_policy == ELogOverflowPolicy::DropBelowWarning && n_header.m_verbosity > ELogVerbosity::Warning
+			&& (m_tail - m_head) + size > m_capacity / 4 * 3)
+	{
+		m_dropped.IncrementExchange();
+		return false;
+	}
+
+	// Records don't wrap. If this one doesn't fit into what's left at the end,
+	// that bit is skipped and it goes to the start
+	uint64 needed = 0;
+	for (;;)
+	{
+		if (m_head == m_tail)
+		{
+			// Empty, so I can start at the beginning and have all of it in one piece
+			m_head = m_tail = ((m_tail + m_capacity - 1) / m_capacity) * m_capacity;
+		}
+
+		const uint64 contiguous = m_capacity - (m_tail % m_capacity);
+		needed = (size <= contiguous) ? size : contiguous + size;
+
+		if (m_capacity - (m_tail - m_head) >= needed)
+		{
+			break;
+		}
+
+		evict_oldest();
+	}
+
+	if (needed > size)
+	{
+		const uint64 contiguous = needed - size;
+		if (contiguous >= s_header_size)
+		{
+			FLogRecordHeader marker{};
+			marker.m_size = s_wrap_marker;
+			std::memcpy(m_data.Get() + (m_tail % m_capacity), &marker, s_header_size);
+		}
+		m_tail += contiguous;
+	}
+
+	uint8 *dest = m_data.Get() + (m_tail % m_capacity);
+	std::memcpy(dest, &n_header, s_header_size);
+	std::memcpy(dest + s_header_size, n_payload, n_header.m_size);
+	m_tail += size;
+
+	m_used.Store(m_tail - m_head);
+	return true;
+}
+
+void FLogRingBuffer::skip_gap() noexcept
+{
+	if (m_head == m_tail)
+	{
+		return;
+	}
+
+	const uint64 contiguous = m_capacity - (m_head % m_capacity);
+	if (contiguous < s_header_size)
+	{
+		m_head += contiguous;
+		return;
+	}
+
+	FLogRecordHeader header;
+	std::memcpy(&header, m_data.Get() + (m_head % m_capacity), s_header_size);
+	if (header.m_size == s_wrap_marker)
+	{
+		m_head += contiguous;
+	}
+}
+
+void FLogRingBuffer::evict_oldest() noexcept
+{
+	skip_gap();
+	if (m_head == m_tail)
+	{
+		return;
+	}
+
+	FLogRecordHeader header;
+	std::memcpy(&header, m_data.Get() + (m_head % m_capacity), s_header_size);
+	m_head += record_size(header.m_size);
+	m_dropped.IncrementExchange();
+}
+
+bool FLogRingBuffer::pop(FLogRecordHeader &n_header, TArray<uint8> &n_payload) noexcept
+{
+	FScopeLock lock(&m_lock);
+
+	skip_gap();
+	if (m_head == m_tail)
+	{
+		m_used.Store(0);
+		return false;
+	}
+
+	const uint8 *src = m_data.Get() + (m_head % m_capacity);
+	std::memcpy(&n_header, src, s_header_size);
+	n_payload.SetNumUninitialized(n_header.m_size, false);
+	std::memcpy(n_payload.GetData(), src + s_header_size, n_header.m_size);
+	m_head += record_size(n_header.m_size);
+
+	m_used.Store(m_tail - m_head);
+	return true;
+}
+
+uint64 FLogRingBuffer::used_bytes() const noexcept
+{
+	return m_used.Load(EMemoryOrder::Relaxed);
+}
+
+bool FLogRingBuffer::is_empty() const noexcept
+{
+	return used_bytes() == 0;
+}
+
+uint64 FLogRingBuffer::dropped_lines() const noexcept
+{
+	return m_dropped.Load(EMemoryOrder::Relaxed);
+}
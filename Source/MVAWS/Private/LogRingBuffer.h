@@ -0,0 +1,98 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+#include "Templates/Atomic.h"
+#include "Logging/LogVerbosity.h"
+
+/*!
+ * What happens to log lines when the buffer is full.
+ */
+enum class ELogOverflowPolicy : uint8
+{
+	/// Oldest lines make room for new ones
+	DropOldest,
+
+	/*!
+	 * Lines less severe than warnings are refused once the buffer is 3/4 full,
+	 * keeping the rest for warnings and errors. Those drop the oldest lines
+	 * if the buffer is full nevertheless.
+	 */
+	DropBelowWarning
+};
+
+/*!
+ * Describes one log line in the buffer, followed by m_size bytes of payload
+ */
+struct FLogRecordHeader
+{
+	int64    m_timestamp;        //!< millis since epoch
+	uint32   m_size;             //!< payload bytes
+	uint32   m_category;         //!< display index of the category's FName
+	int32    m_category_number;  //!< number of the category's FName
+	uint8    m_verbosity;        //!< ELogVerbosity::Type
+};
+
+/*!
+ * Fixed size buffer for log lines, allocated once up front.
+ * Lines are stored back to back as header followed by the payload, wrapping
+ * around at the end. Any thread may push, one thread pops.
+ * When full, lines are dropped according to the policy. I count those.
+ */
+class FLogRingBuffer
+{
+	public:
+		FLogRingBuffer(const uint64 n_capacity, const ELogOverflowPolicy n_policy);
+
+		FLogRingBuffer(const FLogRingBuffer &) = delete;
+		FLogRingBuffer &operator=(const FLogRingBuffer &) = delete;
+
+		/*!
+		 * Copy a line into the buffer. Thread safe.
+		 * n_payload has to hold m_size bytes as given in the header.
+		 * \return false if the line was dropped
+		 */
+		bool push(const FLogRecordHeader &n_header, const void *n_payload) noexcept;
+
+		/*!
+		 * Take the oldest line out. Single consumer only.
+		 * \return false if the buffer is empty
+		 */
+		bool pop(FLogRecordHeader &n_header, TArray<uint8> &n_payload) noexcept;
+
+		/// Bytes in use, including headers. Approximate as it's not synchronized
+		uint64 used_bytes() const noexcept;
+
+		bool is_empty() const noexcept;
+
+		/// Lines dropped since construction
+		uint64 dropped_lines() const noexcept;
+
+	private:
+		/// bytes a record of n_size payload bytes occupies
+		static uint64 record_size(const uint32 n_size) noexcept;
+
+		/// skip the wrap gap at the head if there is one. Lock must be held
+		void skip_gap() noexcept;
+
+		/// drop the oldest line. Lock must be held
+		void evict_oldest() noexcept;
+
+		const uint64             m_capacity;
+		const ELogOverflowPolicy m_policy;
+		TUniquePtr<uint8[]>      m_data;
+
+		// Ever increasing byte positions, modulo capacity gives the offset
+		uint64                   m_head = 0;
+		uint64                   m_tail = 0;
+
+		// tail - head, readable without the lock
+		TAtomic<uint64>          m_used{ 0 };
+		TAtomic<uint64>          m_dropped{ 0 };
+
+		FCriticalSection         m_lock;
+};
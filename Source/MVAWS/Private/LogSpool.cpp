@@ -0,0 +1,346 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#include "LogSpool.h"
+#include "IMVAWS.h"
+
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/Paths.h"
+
+namespace {
+
+// Precedes every line in a segment. The magic tells a line from the garbage
+// a crash may have left at the end of a segment
+struct spool_record {
+	uint32  m_magic;
+	uint32  m_size;
+	int64   m_timestamp;
+};
+
+constexpr uint32 s_record_magic = 0x4D564C31;   // "MVL1"
+constexpr uint32 s_cursor_magic = 0x4D564331;   // "MVC1"
+constexpr int64  s_record_header = sizeof(spool_record);
+
+// Read position as persisted in the cursor file
+struct spool_cursor {
+	uint32  m_magic;
+	uint32  m_reserved;
+	uint64  m_segment;
+	int64   m_offset;
+};
+
+const TCHAR *s_segment_extension = TEXT(".spool");
+}
+
+FLogSpool::FLogSpool(const FString &n_directory, const uint64 n_segment_bytes, const uint64 n_max_bytes)
+		: m_directory{ n_directory }
+		, m_segment_bytes{ n_segment_bytes }
+		, m_max_bytes{ FMath::Max(n_max_bytes, n_segment_bytes) }
+{
+}
+
+FLogSpool::~FLogSpool() noexcept
+{
+	m_reader.Reset();
+	m_writer.Reset();
+}
+
+FString FLogSpool::segment_path(const uint64 n_number) const
+{
+	return FPaths::Combine(m_directory, FString::Printf(TEXT("%020llu%s"), n_number, s_segment_extension));
+}
+
+FString FLogSpool::cursor_path() const
+{
+	return FPaths::Combine(m_directory, TEXT("cursor"));
+}
+
+bool FLogSpool::open() noexcept
+{
+	IPlatformFile &platform_file = FPlatformFileManager::Get().GetPlatformFile();
+	if (!platform_file.CreateDirectoryTree(*m_directory))
+	{
+		return false;
+	}
+
+	// Whatever previous runs left behind
+	TArray<FString> files;
+	IFileManager::Get().FindFiles(files, *m_directory, s_segment_extension);
+	for (const FString &file : files)
+	{
+		const uint64 number = FCString::Strtoui64(*FPaths::GetBaseFilename(file), nullptr, 10);
+		const int64 size = platform_file.FileSize(*segment_path(number));
+		if (number && size >= 0)
+		{
+			m_segments.Add({ number, size });
+			m_total_bytes += size;
+		}
+	}
+	m_segments.Sort([](const segment &n_lhs, const segment &n_rhs) { return n_lhs.m_number < n_rhs.m_number; });
+
+	// Where the last run got with sending. A crash between writing the new cursor
+	// and renaming it leaves only the new one
+	const FString new_cursor_path = cursor_path() + TEXT(".new");
+	TUniquePtr<IFileHandle> cursor_file{ platform_file.OpenRead(
+			*(platform_file.FileExists(*cursor_path()) ? cursor_path() : new_cursor_path)) };
+	spool_cursor cursor{};
+	if (cursor_file && cursor_file->Read(reinterpret_cast<uint8 *>(&cursor), sizeof(cursor)) && cursor.m_magic == s_cursor_magic)
+	{
+		m_committed.m_segment = cursor.m_segment;
+		m_committed.m_offset = cursor.m_offset;
+	}
+	cursor_file.Reset();
+
+	const int32 first = find_segment(m_committed.m_segment);
+	if (first == INDEX_NONE || m_segments[first].m_number != m_committed.m_segment)
+	{
+		// cursor points to a deleted segment, start at the oldest there is
+		m_committed.m_segment = (first == INDEX_NONE) ? 0 : m_segments[first].m_number;
+		m_committed.m_offset = 0;
+	}
+
+	// Segments completely sent before
+	for (int32 i = 0; i < m_segments.Num() && m_segments[i].m_number < m_committed.m_segment; )
+	{
+		platform_file.DeleteFile(*segment_path(m_segments[i].m_number));
+		m_total_bytes -= m_segments[i].m_size;
+		m_segments.RemoveAt(i);
+	}
+
+	if (!m_segments.IsEmpty())
+	{
+		UE_LOG(LogMVAWS, Display, TEXT("Replaying %llu bytes of spooled CloudWatch logs"), m_total_bytes - m_committed.m_offset);
+	}
+
+	// I never append to segments of earlier runs, they may end in a partial line
+	if (!start_segment())
+	{
+		return false;
+	}
+
+	if (!m_committed.m_segment)
+	{
+		m_committed.m_segment = m_segments.Last().m_number;
+	}
+
+	m_read = m_last_read = m_committed;
+	return true;
+}
+
+int32 FLogSpool::find_segment(const uint64 n_number) const noexcept
+{
+	for (int32 i = 0; i < m_segments.Num(); ++i)
+	{
+		if (m_segments[i].m_number >= n_number)
+		{
+			return i;
+		}
+	}
+
+	return INDEX_NONE;
+}
+
+bool FLogSpool::start_segment() noexcept
+{
+	const uint64 number = m_segments.IsEmpty() ? 1 : m_segments.Last().m_number + 1;
+
+	m_writer.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenWrite(*segment_path(number), false, true));
+	if (!m_writer)
+	{
+		return false;
+	}
+
+	m_segments.Add({ number, 0 });
+	return true;
+}
+
+bool FLogSpool::append(const int64 n_timestamp, const char *n_message, const uint32 n_size) noexcept
+{
+	// Writing failed before, try again with a new segment
+	if (!m_writer && !start_segment())
+	{
+		return false;
+	}
+
+	const int64 size = s_record_header + n_size;
+	if (m_segments.Last().m_size > 0 && static_cast<uint64>(m_segments.Last().m_size + size) > m_segment_bytes)
+	{
+		m_writer.Reset();
+		if (!start_segment())
+		{
+			return false;
+		}
+
+		enforce_limit();
+	}
+
+	const spool_record record{ s_record_magic, n_size, n_timestamp };
+	if (!m_writer->Write(reinterpret_cast<const uint8 *>(&record), s_record_header)
+			|| !m_writer->Write(reinterpret_cast<const uint8 *>(n_message), n_size))
+	{
+		// Whatever made it may be a partial line. I continue in a new segment
+		const int64 written = m_writer->Tell();
+		m_total_bytes += written - m_segments.Last().m_size;
+		m_segments.Last().m_size = written;
+		m_writer.Reset();
+		return false;
+	}
+
+	m_segments.Last().m_size += size;
+	m_total_bytes += size;
+	return true;
+}
+
+void FLogSpool::enforce_limit() noexcept
+{
+	IPlatformFile &platform_file = FPlatformFileManager::Get().GetPlatformFile();
+
+	uint64 deleted = 0;
+	while (m_total_bytes > m_max_bytes && m_segments.Num() > 1)
+	{
+		const segment oldest = m_segments[0];
+		if (m_reader && m_reader_segment == oldest.m_number)
+		{
+			m_reader.Reset();
+		}
+
+		platform_file.DeleteFile(*segment_path(oldest.m_number));
+		m_total_bytes -= oldest.m_size;
+		deleted += oldest.m_size;
+		m_segments.RemoveAt(0);
+
+		// Reading continues with what's left
+		for (position *pos : { &m_read, &m_last_read, &m_committed })
+		{
+			if (pos->m_segment <= oldest.m_number)
+			{
+				pos->m_segment = m_segments[0].m_number;
+				pos->m_offset = 0;
+			}
+		}
+	}
+
+	if (deleted)
+	{
+		UE_LOG(LogMVAWS, Warning, TEXT("CloudWatch log spool full, %llu bytes of unsent logs deleted"), deleted);
+	}
+}
+
+bool FLogSpool::read(int64 &n_timestamp, Aws::String &n_message) noexcept
+{
+	for (;;)
+	{
+		const int32 index = find_segment(m_read.m_segment);
+		if (index == INDEX_NONE)
+		{
+			return false;
+		}
+
+		const segment &current = m_segments[index];
+		if (current.m_number != m_read.m_segment)
+		{
+			m_read.m_segment = current.m_number;
+			m_read.m_offset = 0;
+		}
+
+		if (m_read.m_offset + s_record_header <= current.m_size)
+		{
+			// Reopened when the segment grew, in case the handle caches what it read
+			if (!m_reader || m_reader_segment != current.m_number || m_reader_size < current.m_size)
+			{
+				m_reader.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenRead(*segment_path(current.m_number), true));
+				m_reader_segment = current.m_number;
+				m_reader_size = current.m_size;
+			}
+
+			spool_record record;
+			if (m_reader && m_reader->Seek(m_read.m_offset)
+					&& m_reader->Read(reinterpret_cast<uint8 *>(&record), s_record_header)
+					&& record.m_magic == s_record_magic
+					&& m_read.m_offset + s_record_header + record.m_size <= current.m_size)
+			{
+				n_message.resize(record.m_size);
+				if (m_reader->Read(reinterpret_cast<uint8 *>(&n_message[0]), record.m_size))
+				{
+					n_timestamp = record.m_timestamp;
+					m_last_read = m_read;
+					m_read.m_offset += s_record_header + record.m_size;
+					return true;
+				}
+			}
+
+			// A broken line means the rest of the segment is garbage
+		}
+
+		// The one being written may still grow
+		if (index == m_segments.Num() - 1)
+		{
+			return false;
+		}
+
+		m_read.m_segment = m_segments[index + 1].m_number;
+		m_read.m_offset = 0;
+	}
+}
+
+void FLogSpool::unread() noexcept
+{
+	m_read = m_last_read;
+}
+
+void FLogSpool::rewind() noexcept
+{
+	m_read = m_last_read = m_committed;
+}
+
+bool FLogSpool::has_unread() const noexcept
+{
+	if (m_segments.IsEmpty())
+	{
+		return false;
+	}
+
+	const segment &last = m_segments.Last();
+	return m_read.m_segment < last.m_number || m_read.m_offset < last.m_size;
+}
+
+void FLogSpool::commit() noexcept
+{
+	m_committed = m_read;
+	write_cursor();
+
+	// Segments before the read position are done with
+	IPlatformFile &platform_file = FPlatformFileManager::Get().GetPlatformFile();
+	while (m_segments.Num() > 1 && m_segments[0].m_number < m_committed.m_segment)
+	{
+		if (m_reader && m_reader_segment == m_segments[0].m_number)
+		{
+			m_reader.Reset();
+		}
+
+		platform_file.DeleteFile(*segment_path(m_segments[0].m_number));
+		m_total_bytes -= m_segments[0].m_size;
+		m_segments.RemoveAt(0);
+	}
+}
+
+void FLogSpool::write_cursor() const noexcept
+{
+	const spool_cursor cursor{ s_cursor_magic, 0, m_committed.m_segment, m_committed.m_offset };
+
+	// Written aside and renamed, so a crash never leaves a torn cursor behind
+	IPlatformFile &platform_file = FPlatformFileManager::Get().GetPlatformFile();
+	const FString new_cursor_path = cursor_path() + TEXT(".new");
+	{
+		TUniquePtr<IFileHandle> file{ platform_file.OpenWrite(*new_cursor_path) };
+		if (!file || !file->Write(reinterpret_cast<const uint8 *>(&cursor), sizeof(cursor)) || !file->Flush())
+		{
+			return;
+		}
+	}
+
+	platform_file.DeleteFile(*cursor_path());
+	platform_file.MoveFile(*cursor_path(), *new_cursor_path);
+}
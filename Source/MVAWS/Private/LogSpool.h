@@ -0,0 +1,103 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GenericPlatform/GenericPlatformFile.h"
+
+#include "Windows/PreWindowsApi.h"
+#include <aws/core/Aws.h>
+#include <aws/core/utils/memory/stl/AWSString.h>
+#include "Windows/PostWindowsApi.h"
+
+/*!
+ * Append-only spool for log lines on local disk, split into numbered segment files.
+ * Lines are appended as they come and read back for sending. How far reading got
+ * is only persisted once the lines were sent, so whatever didn't make it to CloudWatch
+ * is read again after a restart or after CloudWatch couldn't be reached.
+ * When the spool exceeds its size limit, the oldest segments are deleted.
+ * Not thread safe, I'm meant to be used by the logger thread only.
+ */
+class FLogSpool
+{
+	public:
+		/*!
+		 * @param n_directory where segments go. Must not be shared with another process
+		 * @param n_segment_bytes a new segment is started when the current one would exceed this
+		 * @param n_max_bytes all segments together won't exceed this for long
+		 */
+		FLogSpool(const FString &n_directory, const uint64 n_segment_bytes, const uint64 n_max_bytes);
+		~FLogSpool() noexcept;
+
+		FLogSpool(const FLogSpool &) = delete;
+		FLogSpool &operator=(const FLogSpool &) = delete;
+
+		/*!
+		 * Pick up segments and read position left behind and start a new segment to write to.
+		 * Blocking file IO.
+		 * \return false if the directory isn't usable
+		 */
+		bool open() noexcept;
+
+		/// Append one line. Returns false if it couldn't be written
+		bool append(const int64 n_timestamp, const char *n_message, const uint32 n_size) noexcept;
+
+		/// Read the next line after the read position. Returns false if there is none
+		bool read(int64 &n_timestamp, Aws::String &n_message) noexcept;
+
+		/// Step back before the line read last, so it's read again. Only once after each read()
+		void unread() noexcept;
+
+		/// Everything up to the read position was sent. Persist that and delete used up segments
+		void commit() noexcept;
+
+		/// Back to the last commit so everything after it is read again
+		void rewind() noexcept;
+
+		bool has_unread() const noexcept;
+
+	private:
+		struct position {
+			uint64   m_segment = 0;
+			int64    m_offset = 0;
+		};
+
+		struct segment {
+			uint64   m_number;
+			int64    m_size;
+		};
+
+		FString segment_path(const uint64 n_number) const;
+		FString cursor_path() const;
+
+		/// index into m_segments of the segment with this number or the next one after it
+		int32 find_segment(const uint64 n_number) const noexcept;
+
+		/// start a new segment to write to
+		bool start_segment() noexcept;
+
+		/// delete oldest segments while over the size limit
+		void enforce_limit() noexcept;
+
+		void write_cursor() const noexcept;
+
+		const FString            m_directory;
+		const uint64             m_segment_bytes;
+		const uint64             m_max_bytes;
+
+		/// ascending, the last one is written to
+		TArray<segment>          m_segments;
+		uint64                   m_total_bytes = 0;
+
+		TUniquePtr<IFileHandle>  m_writer;
+
+		TUniquePtr<IFileHandle>  m_reader;
+		uint64                   m_reader_segment = 0;
+		int64                    m_reader_size = 0;
+
+		position                 m_read;
+		position                 m_last_read;
+		position                 m_committed;
+};
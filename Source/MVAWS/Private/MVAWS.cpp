@@ -11,6 +11,8 @@
 #include "S3Impl.h"
 #include "SQSImpl.h"
 
+#include "Misc/Paths.h"
+
 #include "Windows/PreWindowsApi.h"
 #include <aws/core/client/ClientConfiguration.h>
 #include <aws/core/client/AWSError.h>
@@ -39,12 +41,28 @@ void FMVAWSModule::init_actor_ready(const AAWSConnectionConfig *n_config) {
 	
 	if (n_config && n_config->Active) {
 		m_xray_enabled = xray_enabled(n_config->XRayEnabled);
+		if (m_xray_enabled) {
+			m_xray_impl->start(n_config->XRayTransport == EXRayTransport::Daemon);
+		}
 
 		// Create a CloudWatch log output device so all logs
 		// will be sent to CloudWatch
 		if (cloudwatch_logs_enabled(n_config->CloudWatchLogs)) {
 			if (!s_cwl_output_device) {
-				s_cwl_output_device.Reset(new FCloudWatchLogOutputDevice(n_config->CloudWatchLogGroupPrefix));
+				FCloudWatchLogSettings log_settings;
+				log_settings.m_log_group_prefix = n_config->CloudWatchLogGroupPrefix;
+				log_settings.m_buffer_bytes = static_cast<uint64>(n_config->CloudWatchLogBufferMB) * 1024 * 1024;
+				log_settings.m_overflow_policy = (n_config->CloudWatchLogOverflow == ECloudWatchLogOverflow::DropBelowWarning)
+						? ELogOverflowPolicy::DropBelowWarning : ELogOverflowPolicy::DropOldest;
+				if (n_config->CloudWatchLogSpool) {
+					log_settings.m_spool_directory = n_config->CloudWatchLogSpoolDirectory.IsEmpty()
+							? FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("MVAWS"), TEXT("LogSpool"))
+							: n_config->CloudWatchLogSpoolDirectory;
+					log_settings.m_spool_directory = FPaths::ConvertRelativePathToFull(log_settings.m_spool_directory);
+				}
+				log_settings.m_spool_segment_bytes = static_cast<uint64>(n_config->CloudWatchLogSpoolSegmentMB) * 1024 * 1024;
+				log_settings.m_spool_max_bytes = static_cast<uint64>(n_config->CloudWatchLogSpoolMaxMB) * 1024 * 1024;
+				s_cwl_output_device.Reset(new FCloudWatchLogOutputDevice(log_settings));
 			}
 
 			GLog->AddOutputDevice(s_cwl_output_device.Get());
@@ -52,6 +70,52 @@ void FMVAWSModule::init_actor_ready(const AAWSConnectionConfig *n_config) {
 
 		m_s3_impl->set_default_bucket_name(readenv(n_config->BucketNameEnvVariableName, n_config->BucketName));
 
+		FS3UploadSettings upload_settings;
+		upload_settings.m_multipart_threshold = static_cast<uint64>(n_config->MultipartThresholdMB) * 1024 * 1024;
+		upload_settings.m_part_size = static_cast<uint64>(n_config->MultipartPartSizeMB) * 1024 * 1024;
+		upload_settings.m_parts_in_flight = static_cast<uint32>(n_config->MultipartConcurrency);
+		upload_settings.m_part_retries = static_cast<uint32>(n_config->MultipartPartRetries);
+		upload_settings.m_max_concurrent_uploads = static_cast<uint32>(n_config->MaxConcurrentUploads);
+		upload_settings.m_buffer_budget = static_cast<uint64>(n_config->UploadMemoryBudgetMB) * 1024 * 1024;
+		if (n_config->S3ResumableUploads) {
+			upload_settings.m_journal_directory = n_config->S3UploadJournalDirectory.IsEmpty()
+					? FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("MVAWS"), TEXT("UploadJournal"))
+					: n_config->S3UploadJournalDirectory;
+		}
+		upload_settings.m_upload_retries = static_cast<uint32>(n_config->S3UploadRetries);
+		upload_settings.m_retry_base_delay = n_config->S3RetryBaseDelayMs / 1000.0f;
+		upload_settings.m_retry_max_delay = n_config->S3RetryMaxDelayMs / 1000.0f;
+		upload_settings.m_retry_budget_ratio = n_config->S3RetryBudgetPercent / 100.0f;
+		upload_settings.m_journal_ttl = FTimespan::FromHours(n_config->S3AbortIncompleteUploadsAfterHours);
+		m_s3_impl->set_upload_settings(upload_settings);
+
+		FS3DownloadSettings download_settings;
+		download_settings.m_part_size = static_cast<uint64>(n_config->S3DownloadPartSizeMB) * 1024 * 1024;
+		download_settings.m_parts_in_flight = static_cast<uint32>(n_config->S3DownloadConcurrency);
+		download_settings.m_part_retries = static_cast<uint32>(n_config->MultipartPartRetries);
+		download_settings.m_retries = static_cast<uint32>(n_config->S3UploadRetries);
+		download_settings.m_retry_base_delay = upload_settings.m_retry_base_delay;
+		download_settings.m_retry_max_delay = upload_settings.m_retry_max_delay;
+		m_s3_impl->set_download_settings(download_settings);
+
+		FS3CacheSettings cache_settings;
+		cache_settings.m_directory = n_config->S3CacheDirectory.IsEmpty()
+				? FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("MVAWS"), TEXT("ObjectCache"))
+				: n_config->S3CacheDirectory;
+		cache_settings.m_directory = FPaths::ConvertRelativePathToFull(cache_settings.m_directory);
+		cache_settings.m_max_bytes = static_cast<uint64>(n_config->S3CacheSizeMB) * 1024 * 1024;
+		cache_settings.m_revalidate_after = FTimespan::FromSeconds(n_config->S3CacheRevalidateSeconds);
+		m_s3_impl->set_cache_settings(cache_settings);
+
+		FS3ClientSettings client_settings;
+		client_settings.m_max_connections = static_cast<uint32>(n_config->S3MaxConnections);
+		client_settings.m_connect_timeout_ms = static_cast<uint32>(n_config->S3ConnectTimeoutMs);
+		client_settings.m_request_timeout_ms = static_cast<uint32>(n_config->S3RequestTimeoutMs);
+		client_settings.m_tcp_keep_alive = n_config->S3TcpKeepAlive;
+		client_settings.m_tcp_keep_alive_interval_ms = static_cast<uint32>(n_config->S3TcpKeepAliveIntervalMs);
+		client_settings.m_prewarm_connections = static_cast<uint32>(n_config->S3PrewarmConnections);
+		m_s3_impl->start_client(client_settings);
+
 		if (n_config->AWSLogs) {
 			// You won't need logging in live system. This is file IO after all.
 			// Disable this for production unless you need it
@@ -60,7 +124,8 @@ void FMVAWSModule::init_actor_ready(const AAWSConnectionConfig *n_config) {
 					"MVAllocationTag", Aws::Utils::Logging::LogLevel::Info, "aws_sdk_"));
 		}
 
-		m_sqs_impl->set_parameters(n_config->QueueURL, n_config->LongPollWait, n_config->SQSHandlerOnGameThread);
+		m_sqs_impl->set_parameters(n_config->QueueURL, n_config->LongPollWait, n_config->SQSHandlerOnGameThread,
+				n_config->SQSPrefetchMessages, n_config->SQSVisibilityHeartbeat);
 
 		if (cloudwatch_metrics_enabled(n_config->CloudWatchMetrics)) {
 			m_monitoring_impl->start_metrics();
@@ -108,6 +173,15 @@ void FMVAWSModule::ShutdownModule() {
 
 	UE_LOG(LogMVAWS, Display, TEXT("Shutting down AWS Connector Plugin"));
 
+	// SDK objects must be gone before the SDK shuts down
+	if (m_s3_impl) {
+		m_s3_impl->shutdown();
+	}
+
+	if (m_xray_impl) {
+		m_xray_impl->shutdown();
+	}
+
 	Aws::Utils::Logging::ShutdownAWSLogging();
 
 	Aws::ShutdownAPI(m_sdk_options);
@@ -120,6 +194,13 @@ bool FMVAWSModule::cache_upload(const FS3UploadTarget &n_target, TUniquePtr<unsi
 	return m_s3_impl->cache_upload(n_target, MoveTemp(n_data), n_size, n_trace_id, n_completion);
 }
 
+bool FMVAWSModule::cache_upload_blocking(const FS3UploadTarget &n_target, TUniquePtr<unsigned char[]> &&n_data,
+		const size_t n_size, const FTimespan &n_max_wait, const FString &n_trace_id, const FOnCacheUploadFinished n_completion) 
+{
+	checkf(m_s3_impl, TEXT("S3 impl object was not created"));
+	return m_s3_impl->cache_upload_blocking(n_target, MoveTemp(n_data), n_size, n_max_wait, n_trace_id, n_completion);
+}
+
 bool FMVAWSModule::cache_upload(const FS3UploadTarget &n_target, const FString &n_file_path,
 	const FString &n_trace_id, const FOnCacheUploadFinished n_completion)
 {
@@ -127,10 +208,31 @@ bool FMVAWSModule::cache_upload(const FS3UploadTarget &n_target, const FString &
 	return m_s3_impl->cache_upload(n_target, n_file_path, n_trace_id, n_completion);
 }
 
-bool FMVAWSModule::start_sqs_poll(FOnSQSMessageReceived &&n_delegate)
+bool FMVAWSModule::cache_download(const FS3DownloadSource &n_source, const FOnCacheDownloadFinished n_completion,
+	const FString &n_trace_id)
+{
+	checkf(m_s3_impl, TEXT("S3 impl object was not created"));
+	return m_s3_impl->cache_download(n_source, n_completion, n_trace_id);
+}
+
+bool FMVAWSModule::cache_download(const FS3DownloadSource &n_source, const FString &n_file_path,
+	const FString &n_trace_id, const FOnCacheDownloadToFileFinished n_completion)
+{
+	checkf(m_s3_impl, TEXT("S3 impl object was not created"));
+	return m_s3_impl->cache_download(n_source, n_file_path, n_trace_id, n_completion);
+}
+
+bool FMVAWSModule::cached_download(const FS3DownloadSource &n_source, const FOnCachedDownloadFinished n_completion,
+	const FString &n_trace_id)
+{
+	checkf(m_s3_impl, TEXT("S3 impl object was not created"));
+	return m_s3_impl->cached_download(n_source, n_completion, n_trace_id);
+}
+
+bool FMVAWSModule::start_sqs_poll(FOnSQSMessageReceived &&n_delegate, const int n_max_in_flight)
 {
 	checkf(m_sqs_impl, TEXT("SQS impl object was not created"));
-	return m_sqs_impl->start_polling(MoveTemp(n_delegate));
+	return m_sqs_impl->start_polling(MoveTemp(n_delegate), n_max_in_flight);
 }
 
 void FMVAWSModule::stop_sqs_poll()
@@ -140,6 +242,15 @@ void FMVAWSModule::stop_sqs_poll()
 	m_sqs_impl->join();
 }
 
+FString FMVAWSModule::new_trace_id() 
+{
+	checkf(m_xray_impl, TEXT("XRay impl object was not created"));
+	if (!m_xray_enabled) {
+		return {};
+	}
+	return m_xray_impl->new_trace_id();
+}
+
 FString FMVAWSModule::start_trace_segment(const FString &n_trace_id, const FString &n_segment_name) 
 {
 	checkf(m_xray_impl, TEXT("XRay impl object was not created"));
@@ -194,12 +305,48 @@ void FMVAWSModule::count_file_upload(const float n_milliseconds) noexcept
 	return m_monitoring_impl->count_file_s3_upload(n_milliseconds);
 }
 
+void FMVAWSModule::count_download(const float n_milliseconds) noexcept
+{
+	checkf(m_monitoring_impl, TEXT("Monitoring impl object was not created"));
+	return m_monitoring_impl->count_s3_download(n_milliseconds);
+}
+
 void FMVAWSModule::count_sqs_message() noexcept
 {
 	checkf(m_monitoring_impl, TEXT("Monitoring impl object was not created"));
 	return m_monitoring_impl->count_sqs_message();
 }
 
+void FMVAWSModule::count_sqs_message_handled(const float n_handler_milliseconds, const float n_receive_to_ack_milliseconds) noexcept
+{
+	checkf(m_monitoring_impl, TEXT("Monitoring impl object was not created"));
+	return m_monitoring_impl->count_sqs_message_handled(n_handler_milliseconds, n_receive_to_ack_milliseconds);
+}
+
+void FMVAWSModule::count_xray_flush(const float n_milliseconds) noexcept
+{
+	checkf(m_monitoring_impl, TEXT("Monitoring impl object was not created"));
+	return m_monitoring_impl->count_xray_flush(n_milliseconds);
+}
+
+void FMVAWSModule::count_log_lines_dropped(const uint32 n_lines) noexcept
+{
+	checkf(m_monitoring_impl, TEXT("Monitoring impl object was not created"));
+	return m_monitoring_impl->count_log_lines_dropped(n_lines);
+}
+
+void FMVAWSModule::count_s3_retry(const bool n_allowed) noexcept
+{
+	checkf(m_monitoring_impl, TEXT("Monitoring impl object was not created"));
+	return m_monitoring_impl->count_s3_retry(n_allowed);
+}
+
+void FMVAWSModule::count_s3_cache(const bool n_hit) noexcept
+{
+	checkf(m_monitoring_impl, TEXT("Monitoring impl object was not created"));
+	return m_monitoring_impl->count_s3_cache(n_hit);
+}
+
 void FMVAWSModule::set_message_visibilty_timeout(const FMVAWSMessage& n_message, const int n_timeout) noexcept
 {
 	checkf(m_sqs_impl, TEXT("SQS impl object was not created"));
@@ -24,12 +24,23 @@ class FMVAWSModule : public IMVAWSModule
 		bool cache_upload(const FS3UploadTarget &n_target, TUniquePtr<unsigned char []> &&n_data,
 				const size_t n_size, const FString &n_trace_id = FString{}, const FOnCacheUploadFinished n_completion = FOnCacheUploadFinished{}) override;
 
+		bool cache_upload_blocking(const FS3UploadTarget &n_target, TUniquePtr<unsigned char []> &&n_data,
+				const size_t n_size, const FTimespan &n_max_wait, const FString &n_trace_id = FString{}, 
+				const FOnCacheUploadFinished n_completion = FOnCacheUploadFinished{}) override;
+
 		bool cache_upload(const FS3UploadTarget &n_target, const FString &n_file_path,
 			const FString &n_trace_id = FString{}, const FOnCacheUploadFinished n_completion = FOnCacheUploadFinished{}) override;
+		bool cache_download(const FS3DownloadSource &n_source, const FOnCacheDownloadFinished n_completion,
+			const FString &n_trace_id = FString{}) override;
+		bool cache_download(const FS3DownloadSource &n_source, const FString &n_file_path,
+			const FString &n_trace_id = FString{}, const FOnCacheDownloadToFileFinished n_completion = FOnCacheDownloadToFileFinished{}) override;
+		bool cached_download(const FS3DownloadSource &n_source, const FOnCachedDownloadFinished n_completion,
+			const FString &n_trace_id = FString{}) override;
 		
-		bool start_sqs_poll(FOnSQSMessageReceived &&n_delegate) override;
+		bool start_sqs_poll(FOnSQSMessageReceived &&n_delegate, const int n_max_in_flight = 1) override;
 		void stop_sqs_poll() override;
 
+		FString new_trace_id() override;
 		FString start_trace_segment(const FString &n_trace_id, const FString &n_segment_name) override;
 		FString start_trace_subsegment(const FString &n_trace_id, const FString &n_name) override;
 		void end_trace_subsegment(const FString &n_trace_id, const FString n_subsegment_id, const bool n_error = false) override;
@@ -38,7 +49,13 @@ class FMVAWSModule : public IMVAWSModule
 		void count_image_rendered(const float n_milliseconds) noexcept override;
 		void count_membuf_upload(const float n_milliseconds) noexcept override;
 		void count_file_upload(const float n_milliseconds) noexcept override;
+		void count_download(const float n_milliseconds) noexcept override;
 		void count_sqs_message() noexcept override;
+		void count_sqs_message_handled(const float n_handler_milliseconds, const float n_receive_to_ack_milliseconds) noexcept override;
+		void count_xray_flush(const float n_milliseconds) noexcept override;
+		void count_log_lines_dropped(const uint32 n_lines) noexcept override;
+		void count_s3_retry(const bool n_allowed) noexcept override;
+		void count_s3_cache(const bool n_hit) noexcept override;
 
 		void set_message_visibilty_timeout(const FMVAWSMessage& n_message, const int n_timeout) noexcept override;
 
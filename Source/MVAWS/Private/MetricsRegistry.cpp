@@ -0,0 +1,201 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#include "MetricsRegistry.h"
+#include "IMVAWS.h"
+
+// Engine
+#include "HAL/PlatformTLS.h"
+#include "Misc/ScopeLock.h"
+
+#include <limits>
+
+namespace
+{
+
+std::atomic<uint32> s_next_registry_id{ 1 };
+
+struct local_block_cache
+{
+	uint32 m_registry_id = 0;
+	void  *m_block = nullptr;
+};
+
+thread_local local_block_cache t_local_block;
+
+constexpr double s_no_minimum = std::numeric_limits<double>::max();
+constexpr double s_no_maximum = std::numeric_limits<double>::lowest();
+
+} // anon ns
+
+FMetricsRegistry::metric_cell::metric_cell()
+		: m_minimum{ s_no_minimum }
+		, m_maximum{ s_no_maximum }
+{
+}
+
+FMetricsRegistry::FMetricsRegistry()
+		: m_id{ s_next_registry_id.fetch_add(1) }
+{
+	m_metrics.Reserve(s_max_metrics);
+}
+
+FMetricsRegistry::~FMetricsRegistry() noexcept
+{
+	FScopeLock slock(&m_blocks_mutex);
+	m_blocks.Empty();
+}
+
+FMetricHandle FMetricsRegistry::register_metric(const Aws::String &n_metric_name,
+		const Aws::CloudWatch::Model::StandardUnit n_unit, const EMetricKind n_kind)
+{
+	if (m_metrics.Num() >= s_max_metrics)
+	{
+		UE_LOG(LogMVAWS, Error, TEXT("Cannot register metric '%s', all %i slots taken"),
+			UTF8_TO_TCHAR(n_metric_name.c_str()), s_max_metrics);
+		return INDEX_NONE;
+	}
+
+	int32 histogram = INDEX_NONE;
+	if (n_kind == EMetricKind::Histogram)
+	{
+		if (m_histogram_count >= s_max_histograms)
+		{
+			UE_LOG(LogMVAWS, Error, TEXT("Cannot register histogram metric '%s', all %i slots taken"),
+				UTF8_TO_TCHAR(n_metric_name.c_str()), s_max_histograms);
+			return INDEX_NONE;
+		}
+
+		histogram = m_histogram_count++;
+	}
+
+	return m_metrics.Add(metric_info{ n_metric_name, n_unit, n_kind, histogram });
+}
+
+void FMetricsRegistry::record(const FMetricHandle n_metric, const double n_value) noexcept
+{
+	if (n_metric < 0 || n_metric >= m_metrics.Num())
+	{
+		return;
+	}
+
+	thread_block &block = local_block();
+	metric_cell &cell = block.m_cells[n_metric];
+
+	// I am the only writer of count and sum, no need for read-modify-write
+	cell.m_count.store(cell.m_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	cell.m_sum.store(cell.m_sum.load(std::memory_order_relaxed) + n_value, std::memory_order_relaxed);
+
+	// The sweep resets these, so they need to be exchanged. Usually the first try works
+	double minimum = cell.m_minimum.load(std::memory_order_relaxed);
+	while (n_value < minimum && !cell.m_minimum.compare_exchange_weak(minimum, n_value, std::memory_order_relaxed))
+	{
+	}
+
+	double maximum = cell.m_maximum.load(std::memory_order_relaxed);
+	while (n_value > maximum && !cell.m_maximum.compare_exchange_weak(maximum, n_value, std::memory_order_relaxed))
+	{
+	}
+
+	const int32 histogram = m_metrics[n_metric].m_histogram;
+	if (histogram != INDEX_NONE)
+	{
+		const uint64 scaled = static_cast<uint64>(FMath::Max(n_value, 0.0) * s_histogram_scale + 0.5);
+		std::atomic<uint32> &bucket = block.m_histograms[histogram].m_counts[FLogLinearHistogram::bucket_index(scaled)];
+		bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+}
+
+void FMetricsRegistry::sweep(TArray<FMetricSnapshot> &n_snapshots) noexcept
+{
+	n_snapshots.Reset(m_metrics.Num());
+	for (const metric_info &metric : m_metrics)
+	{
+		FMetricSnapshot &snapshot = n_snapshots.AddDefaulted_GetRef();
+		snapshot.m_metric_name = metric.m_metric_name;
+		snapshot.m_unit = metric.m_unit;
+		snapshot.m_kind = metric.m_kind;
+		snapshot.m_minimum = s_no_minimum;
+		snapshot.m_maximum = s_no_maximum;
+		snapshot.m_histogram.reset();
+	}
+
+	FScopeLock slock(&m_blocks_mutex);
+
+	for (const TUniquePtr<thread_block> &block : m_blocks)
+	{
+		for (int32 i = 0; i < n_snapshots.Num(); ++i)
+		{
+			metric_cell &cell = block->m_cells[i];
+			FMetricSnapshot &snapshot = n_snapshots[i];
+
+			const uint64 count = cell.m_count.load(std::memory_order_relaxed);
+			const double sum = cell.m_sum.load(std::memory_order_relaxed);
+
+			snapshot.m_count += count - block->m_swept_count[i];
+			snapshot.m_sum += sum - block->m_swept_sum[i];
+			block->m_swept_count[i] = count;
+			block->m_swept_sum[i] = sum;
+
+			snapshot.m_minimum = FMath::Min(snapshot.m_minimum, cell.m_minimum.exchange(s_no_minimum, std::memory_order_relaxed));
+			snapshot.m_maximum = FMath::Max(snapshot.m_maximum, cell.m_maximum.exchange(s_no_maximum, std::memory_order_relaxed));
+
+			const int32 histogram = m_metrics[i].m_histogram;
+			if (histogram == INDEX_NONE)
+			{
+				continue;
+			}
+
+			const histogram_cells &buckets = block->m_histograms[histogram];
+			uint32 *swept_buckets = block->m_swept_buckets[histogram];
+			for (int32 b = 0; b < FLogLinearHistogram::s_bucket_count; ++b)
+			{
+				const uint32 bucket_count = buckets.m_counts[b].load(std::memory_order_relaxed);
+				if (bucket_count != swept_buckets[b])
+				{
+					snapshot.m_histogram.add_to_bucket(b, bucket_count - swept_buckets[b]);
+					swept_buckets[b] = bucket_count;
+				}
+			}
+		}
+	}
+
+	// Samples racing the sweep may have left their count in one period and min/max
+	// in the next. Don't send nonsense in that case
+	for (FMetricSnapshot &snapshot : n_snapshots)
+	{
+		if (snapshot.m_count == 0 || snapshot.m_minimum > snapshot.m_maximum)
+		{
+			snapshot.m_minimum = snapshot.m_maximum = (snapshot.m_count ? snapshot.m_sum / snapshot.m_count : 0.0);
+		}
+	}
+}
+
+FMetricsRegistry::thread_block &FMetricsRegistry::local_block() noexcept
+{
+	if (t_local_block.m_registry_id != m_id)
+	{
+		// First sample of this thread here, or the thread recorded into another registry
+		// in between. Blocks of exited threads stay around, their values are still swept.
+		// There's only ever a few dozen threads
+		const uint32 thread_id = FPlatformTLS::GetCurrentThreadId();
+
+		FScopeLock slock(&m_blocks_mutex);
+		const TUniquePtr<thread_block> *existing = m_blocks.FindByPredicate([thread_id](const TUniquePtr<thread_block> &n_block) {
+			return n_block->m_thread_id == thread_id;
+		});
+
+		thread_block *block = existing ? existing->Get() : nullptr;
+		if (!block)
+		{
+			block = m_blocks.Add_GetRef(MakeUnique<thread_block>()).Get();
+			block->m_thread_id = thread_id;
+		}
+
+		t_local_block.m_block = block;
+		t_local_block.m_registry_id = m_id;
+	}
+
+	return *static_cast<thread_block *>(t_local_block.m_block);
+}
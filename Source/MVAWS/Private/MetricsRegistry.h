@@ -0,0 +1,145 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+#include "LogLinearHistogram.h"
+
+#include "Windows/PreWindowsApi.h"
+#include <aws/core/Aws.h>
+#include <aws/core/utils/memory/stl/AWSString.h>
+#include <aws/monitoring/model/StandardUnit.h>
+#include "Windows/PostWindowsApi.h"
+
+#include <atomic>
+
+/// Index of a registered metric
+using FMetricHandle = int32;
+
+/*!
+ * Counters are sent as a single value (the sum of all increments), even when zero.
+ * Distributions are sent as statistic set and only when there were samples.
+ * Histograms are sent as values and counts of their buckets so CloudWatch can
+ * compute percentiles, also only when there were samples.
+ */
+enum class EMetricKind : uint8
+{
+	Counter,
+	Distribution,
+	Histogram
+};
+
+/*!
+ * What happened to one metric since the last sweep, summed up over all threads
+ */
+struct FMetricSnapshot
+{
+	Aws::String                          m_metric_name;
+	Aws::CloudWatch::Model::StandardUnit m_unit;
+	EMetricKind                          m_kind;
+	uint64                               m_count = 0;
+	double                               m_sum = 0.0;
+	double                               m_minimum = 0.0;
+	double                               m_maximum = 0.0;
+
+	/// Histogram kind only. Values are in thousandths of m_unit
+	FLogLinearHistogram                  m_histogram;
+};
+
+/*!
+ * Records metric samples without locks or allocations.
+ *
+ * Metrics are registered once up front and referred to by handle afterwards.
+ * Each recording thread gets a block of cache line sized accumulators of its own
+ * on first use, so recording a sample is a handful of relaxed atomic operations
+ * on memory no other thread writes to. The metrics thread sweeps all blocks
+ * from time to time and sums them up.
+ *
+ * Count and sum only ever grow, the sweep keeps track of what it has already seen.
+ * Minimum and maximum are reset by the sweep. Histogram buckets are counted the same way
+ * as count and sum. They have a resolution of a thousandth of the metric's unit, so
+ * microseconds for metrics in milliseconds.
+ */
+class FMetricsRegistry
+{
+	public:
+		static constexpr int32 s_max_metrics = 16;
+		static constexpr int32 s_max_histograms = 8;
+
+		/// Histograms count values in thousandths of the unit
+		static constexpr double s_histogram_scale = 1000.0;
+
+		FMetricsRegistry();
+		~FMetricsRegistry() noexcept;
+
+		FMetricsRegistry(const FMetricsRegistry &) = delete;
+		FMetricsRegistry &operator=(const FMetricsRegistry &) = delete;
+
+		/*!
+		 * Register a metric. Not thread safe, do this before anyone records.
+		 * \return handle to record samples with, INDEX_NONE if all (histogram) slots are taken
+		 */
+		FMetricHandle register_metric(const Aws::String &n_metric_name,
+				const Aws::CloudWatch::Model::StandardUnit n_unit, const EMetricKind n_kind);
+
+		/// Add a sample. Lock free, can be called from any thread
+		void record(const FMetricHandle n_metric, const double n_value) noexcept;
+
+		/// Collect what all threads recorded since the last sweep, one snapshot per metric
+		void sweep(TArray<FMetricSnapshot> &n_snapshots) noexcept;
+
+	private:
+		struct alignas(PLATFORM_CACHE_LINE_SIZE) metric_cell
+		{
+			std::atomic<uint64> m_count{ 0 };
+			std::atomic<double> m_sum{ 0.0 };
+			std::atomic<double> m_minimum;
+			std::atomic<double> m_maximum;
+
+			metric_cell();
+		};
+
+		struct alignas(PLATFORM_CACHE_LINE_SIZE) histogram_cells
+		{
+			// 32 bits wrap after a few billion samples but sweeps take the difference
+			std::atomic<uint32> m_counts[FLogLinearHistogram::s_bucket_count] = {};
+		};
+
+		/// Accumulators of one recording thread
+		struct thread_block
+		{
+			/// owner, so a thread coming back from another registry finds its block again
+			uint32          m_thread_id = 0;
+
+			metric_cell     m_cells[s_max_metrics];
+			histogram_cells m_histograms[s_max_histograms];
+
+			// what the sweep has taken already. Only touched by the sweeping thread
+			uint64          m_swept_count[s_max_metrics] = {};
+			double          m_swept_sum[s_max_metrics] = {};
+			uint32          m_swept_buckets[s_max_histograms][FLogLinearHistogram::s_bucket_count] = {};
+		};
+
+		struct metric_info
+		{
+			Aws::String                          m_metric_name;
+			Aws::CloudWatch::Model::StandardUnit m_unit;
+			EMetricKind                          m_kind;
+			int32                                m_histogram = INDEX_NONE;
+		};
+
+		/// Find or create the calling thread's block
+		thread_block &local_block() noexcept;
+
+		/// Tells apart registries so threads don't use a block of a destroyed one
+		const uint32                     m_id;
+
+		TArray<metric_info>              m_metrics;
+		int32                            m_histogram_count = 0;
+
+		FCriticalSection                 m_blocks_mutex;
+		TArray<TUniquePtr<thread_block>> m_blocks;        //!< protected by m_blocks_mutex
+};
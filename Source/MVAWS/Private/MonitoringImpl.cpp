@@ -18,6 +18,7 @@
 #include <aws/core/utils/memory/AWSMemory.h>
 #include <aws/monitoring/CloudWatchClient.h>
 #include <aws/monitoring/model/PutMetricDataRequest.h>
+#include <aws/monitoring/model/StatisticSet.h>
 
 #include "Windows/PostWindowsApi.h"
 
@@ -90,117 +91,141 @@ void UMonitoringImpl::metrics_thread() noexcept
 			FPlatformProcess::Sleep(1.0);
 		}
 
-		if (m_single_values.IsEmpty() && !m_sqs_messages)
-		{
-			send_blank();
-		}
-		else
-		{
-			send_values();
-		}
+		send_values();
 	}
 }
 
-void UMonitoringImpl::send_blank() noexcept
+void UMonitoringImpl::send_values() noexcept
 {
 	Aws::CloudWatch::Model::Dimension iid_dimension;
 	iid_dimension.SetName("InstanceId");
 	iid_dimension.SetValue(TCHAR_TO_UTF8(*m_instance_id));
 
-	// CloudWatch specifically recommends to not have gaps in your values
-	// and send metrics even when nothing happened. This way your application
-	// looks alive when not busy. I will follow that advise but only for SQS messages
-	// as it seems to me sending zero render times might mess up scaling calculations
-	// along the way
 	Aws::CloudWatch::Model::PutMetricDataRequest request;
 	request.SetNamespace("MVAWS/TRAFFIC");
 
-	// Let's add the number of SQS messages first
-	Aws::CloudWatch::Model::MetricDatum sqs_datum;
-	sqs_datum.SetMetricName("SQS_MESSAGES_RECEIVED");
-	sqs_datum.SetUnit(StandardUnit::Count);
-	sqs_datum.SetValue(0);
-	sqs_datum.AddDimensions(iid_dimension);
-	request.AddMetricData(std::move(sqs_datum));
+	m_registry.sweep(m_snapshots);
 
-	const PutMetricDataOutcome outcome = m_cw_client->PutMetricData(request);
-	if (!outcome.IsSuccess())
-	{
-		UE_LOG(LogMVAWS, Warning, TEXT("Failed to put blank sample metric data: %s"),
-			UTF8_TO_TCHAR(outcome.GetError().GetMessage().c_str()));
-	}
-	else
-	{
-		UE_LOG(LogMVAWS, Verbose, TEXT("Successfully put blank sample metric data"));
-	}
-}
+	// A request may hold no more than 20 data, a datum no more than 150 values.
+	// Normally this is a single request but a wide histogram may need more
+	const int32 max_data = 20;
+	const int32 max_values = 150;
 
+	const auto put = [this, &request]()
+	{
+		const PutMetricDataOutcome outcome = m_cw_client->PutMetricData(request);
+		if (!outcome.IsSuccess())
+		{
+			UE_LOG(LogMVAWS, Warning, TEXT("Failed to put sample metric data: %s"),
+					UTF8_TO_TCHAR(outcome.GetError().GetMessage().c_str()));
+		}
+		else
+		{
+			UE_LOG(LogMVAWS, Verbose, TEXT("Successfully put %i metric data"), static_cast<int32>(request.GetMetricData().size()));
+		}
 
-void UMonitoringImpl::send_values() noexcept
-{
-	Aws::CloudWatch::Model::Dimension iid_dimension;
-	iid_dimension.SetName("InstanceId");
-	iid_dimension.SetValue(TCHAR_TO_UTF8(*m_instance_id));
+		request.SetMetricData(Aws::Vector<Aws::CloudWatch::Model::MetricDatum>{});
+	};
 
-	while (!m_single_values.IsEmpty())
+	const auto add = [&request, &put, max_data](Aws::CloudWatch::Model::MetricDatum &&n_datum)
 	{
-		Aws::CloudWatch::Model::PutMetricDataRequest request;
-		request.SetNamespace("MVAWS/TRAFFIC");
-
-		// Let's add the number of SQS messages first
-		Aws::CloudWatch::Model::MetricDatum sqs_datum;
-		sqs_datum.SetMetricName("SQS_MESSAGES_RECEIVED");
-		sqs_datum.SetUnit(StandardUnit::Count);
-		sqs_datum.SetValue(m_sqs_messages.Exchange(0));
-		sqs_datum.AddDimensions(iid_dimension);
-		request.AddMetricData(std::move(sqs_datum));
-		
-		// 20 is the maximum data points in a request.
-		// There's still a size limit but I don't know how to query it
-		// beforehand. I go for lower data points here as we already 
-		// counted SQS messages
-		unsigned int max_data_points = 19;
-
-		// One by one, pop render entries. You know the drill...
-		UMonitoringImpl::single_entry se;
-
-		while (m_single_values.Dequeue(se) && max_data_points--)
+		request.AddMetricData(std::move(n_datum));
+		if (static_cast<int32>(request.GetMetricData().size()) >= max_data)
 		{
-			Aws::CloudWatch::Model::MetricDatum datum;
-			datum.SetMetricName(se.m_metric_name);
-			datum.SetUnit(se.m_unit);
-			datum.SetValue(se.m_value);
-			datum.AddDimensions(iid_dimension);
-			request.AddMetricData(std::move(datum));
+			put();
 		}
+	};
 
-		const PutMetricDataOutcome outcome = m_cw_client->PutMetricData(request);
-		if (!outcome.IsSuccess())
+	for (const FMetricSnapshot &snapshot : m_snapshots)
+	{
+		Aws::CloudWatch::Model::MetricDatum datum;
+		datum.SetMetricName(snapshot.m_metric_name);
+		datum.SetUnit(snapshot.m_unit);
+		datum.AddDimensions(iid_dimension);
+
+		if (snapshot.m_kind == EMetricKind::Counter)
 		{
-			UE_LOG(LogMVAWS, Warning, TEXT("Failed to put sample metric data: %s"),
-					UTF8_TO_TCHAR(outcome.GetError().GetMessage().c_str()));
+			// CloudWatch specifically recommends to not have gaps in your values
+			// and send metrics even when nothing happened. This way your application
+			// looks alive when not busy. I will follow that advise but only for counters
+			// such as SQS messages as it seems to me sending zero render times might
+			// mess up scaling calculations along the way
+			datum.SetValue(snapshot.m_sum);
+			add(std::move(datum));
+		}
+		else if (!snapshot.m_count)
+		{
+			continue;
+		}
+		else if (snapshot.m_kind == EMetricKind::Histogram)
+		{
+			// Each non-empty bucket becomes a value with its count. From these
+			// CloudWatch computes percentiles exactly to bucket resolution
+			Aws::Vector<double> values;
+			Aws::Vector<double> counts;
+			for (int32 b = 0; b < FLogLinearHistogram::s_bucket_count; ++b)
+			{
+				const uint64 count = snapshot.m_histogram.count_at(b);
+				if (!count)
+				{
+					continue;
+				}
+
+				values.push_back(FLogLinearHistogram::bucket_value(b) / FMetricsRegistry::s_histogram_scale);
+				counts.push_back(static_cast<double>(count));
+
+				if (static_cast<int32>(values.size()) == max_values)
+				{
+					Aws::CloudWatch::Model::MetricDatum part = datum;
+					part.SetValues(std::move(values));
+					part.SetCounts(std::move(counts));
+					add(std::move(part));
+					values.clear();
+					counts.clear();
+				}
+			}
+
+			if (!values.empty())
+			{
+				datum.SetValues(std::move(values));
+				datum.SetCounts(std::move(counts));
+				add(std::move(datum));
+			}
+
+			UE_LOG(LogMVAWS, Verbose, TEXT("%s p50 %.1f p95 %.1f p99 %.1f over %llu samples"), UTF8_TO_TCHAR(snapshot.m_metric_name.c_str()),
+				snapshot.m_histogram.value_at_quantile(0.5) / FMetricsRegistry::s_histogram_scale,
+				snapshot.m_histogram.value_at_quantile(0.95) / FMetricsRegistry::s_histogram_scale,
+				snapshot.m_histogram.value_at_quantile(0.99) / FMetricsRegistry::s_histogram_scale,
+				snapshot.m_count);
 		}
 		else
 		{
-			UE_LOG(LogMVAWS, Verbose, TEXT("Successfully put sample metric data"));
+			// One datum per metric, no matter how many samples
+			Aws::CloudWatch::Model::StatisticSet statistics;
+			statistics.SetMinimum(snapshot.m_minimum);
+			statistics.SetMaximum(snapshot.m_maximum);
+			statistics.SetSum(snapshot.m_sum);
+			statistics.SetSampleCount(static_cast<double>(snapshot.m_count));
+			datum.SetStatisticValues(std::move(statistics));
+			add(std::move(datum));
 		}
 	}
+
+	if (!request.GetMetricData().empty())
+	{
+		put();
+	}
 }
 
 void UMonitoringImpl::count_image_rendered(const float n_milliseconds) noexcept
 {
 	// Early exit in case we are not running.
-	// No need to fill that Q
+	// Nobody would sweep this
 	if (m_metrics_interrupted) {
 		return;
 	}
 
-	UMonitoringImpl::single_entry se;
-	se.m_unit = StandardUnit::Milliseconds;
-	se.m_metric_name = "RENDER_TIME";
-	se.m_value = n_milliseconds;
-
-	m_single_values.Enqueue(MoveTemp(se));
+	m_registry.record(m_render_time, n_milliseconds);
 }
 
 void UMonitoringImpl::count_membuf_s3_upload(const float n_milliseconds) noexcept
@@ -209,12 +234,7 @@ void UMonitoringImpl::count_membuf_s3_upload(const float n_milliseconds) noexcep
 		return;
 	}
 
-	UMonitoringImpl::single_entry se;
-	se.m_unit = StandardUnit::Milliseconds;
-	se.m_metric_name = "MEMBUF_UPLOAD";
-	se.m_value = n_milliseconds;
-
-	m_single_values.Enqueue(MoveTemp(se));
+	m_registry.record(m_membuf_upload, n_milliseconds);
 }
 
 void UMonitoringImpl::count_file_s3_upload(const float n_milliseconds) noexcept
@@ -223,15 +243,53 @@ void UMonitoringImpl::count_file_s3_upload(const float n_milliseconds) noexcept
 		return;
 	}
 
-	UMonitoringImpl::single_entry se;
-	se.m_unit = StandardUnit::Milliseconds;
-	se.m_metric_name = "FILE_UPLOAD";
-	se.m_value = n_milliseconds;
+	m_registry.record(m_file_upload, n_milliseconds);
+}
 
-	m_single_values.Enqueue(MoveTemp(se));
+void UMonitoringImpl::count_s3_download(const float n_milliseconds) noexcept
+{
+	if (m_metrics_interrupted) {
+		return;
+	}
+
+	m_registry.record(m_s3_download, n_milliseconds);
 }
 
 void UMonitoringImpl::count_sqs_message() noexcept
 {
-	m_sqs_messages++;
+	m_registry.record(m_sqs_messages, 1.0);
+}
+
+void UMonitoringImpl::count_sqs_message_handled(const float n_handler_milliseconds, const float n_receive_to_ack_milliseconds) noexcept
+{
+	if (m_metrics_interrupted) {
+		return;
+	}
+
+	m_registry.record(m_sqs_handler_time, n_handler_milliseconds);
+	m_registry.record(m_sqs_receive_to_ack, n_receive_to_ack_milliseconds);
+}
+
+void UMonitoringImpl::count_xray_flush(const float n_milliseconds) noexcept
+{
+	if (m_metrics_interrupted) {
+		return;
+	}
+
+	m_registry.record(m_xray_flush, n_milliseconds);
+}
+
+void UMonitoringImpl::count_log_lines_dropped(const uint32 n_lines) noexcept
+{
+	m_registry.record(m_log_lines_dropped, static_cast<double>(n_lines));
+}
+
+void UMonitoringImpl::count_s3_retry(const bool n_allowed) noexcept
+{
+	m_registry.record(n_allowed ? m_s3_retries : m_s3_retries_denied, 1.0);
+}
+
+void UMonitoringImpl::count_s3_cache(const bool n_hit) noexcept
+{
+	m_registry.record(n_hit ? m_s3_cache_hits : m_s3_cache_misses, 1.0);
 }
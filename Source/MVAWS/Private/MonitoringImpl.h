@@ -8,7 +8,7 @@
 #include "HAL/Thread.h"
 #include "Templates/Atomic.h"
 #include "Logging/LogVerbosity.h"
-#include "Containers/Queue.h"
+#include "MetricsRegistry.h"
 
 #include "Windows/PreWindowsApi.h"
 #include <aws/core/Aws.h>
@@ -24,18 +24,15 @@ namespace Aws
 	namespace CloudWatch
 	{
 		class CloudWatchClient;
-
-		namespace Model
-		{
-			enum class StandardUnit;
-		}
 	}
 }
 
 /*! \brief Implementation for cloudwatch metrics
  * Runs a background thread that will send custom metrics
- * to CloudWatch every 10 seconds as long as values
- * have been accumulated during that time
+ * to CloudWatch every 10 seconds. Samples are aggregated per metric
+ * in the meantime and sent as one statistic set each, so the cost
+ * of a cycle doesn't depend on the number of samples.
+ * Recording samples is lock free and doesn't allocate.
  */
 UCLASS()
 class UMonitoringImpl : public UObject 
@@ -67,30 +64,42 @@ class UMonitoringImpl : public UObject
 		 */
 		void count_file_s3_upload(const float n_milliseconds) noexcept;
 
+		/*! \brief register one download from S3, to memory or file
+		 *  will return immediately and queue for sending with the next batch
+		 */
+		void count_s3_download(const float n_milliseconds) noexcept;
+
 		/*! \brief register one received SQS message
 		 *  will return immediately and queue for sending with the next batch
 		 */
 		void count_sqs_message() noexcept;
 
-	private:
+		/*! \brief register one SQS message whose promise was set
+		 *  \param n_handler_milliseconds from handing the message to the delegate until the promise was set
+		 *  \param n_receive_to_ack_milliseconds from receiving the message until the promise was set
+		 */
+		void count_sqs_message_handled(const float n_handler_milliseconds, const float n_receive_to_ack_milliseconds) noexcept;
+
+		/*! \brief register one upload of X-Ray segments
+		 */
+		void count_xray_flush(const float n_milliseconds) noexcept;
 
-		struct single_entry {
-			float                                m_value;
-			Aws::CloudWatch::Model::StandardUnit m_unit;
-			Aws::String                          m_metric_name;
-		};
+		/*! \brief register log lines the CloudWatch log buffer had to drop
+		 */
+		void count_log_lines_dropped(const uint32 n_lines) noexcept;
 
-		using SingleSampleQueue = TQueue<single_entry, EQueueMode::Mpsc>;
+		/*! \brief register a retry of an S3 upload or part, or one the retry budget denied
+		 */
+		void count_s3_retry(const bool n_allowed) noexcept;
 
-		void metrics_thread() noexcept;
+		/*! \brief register a hit or miss of the S3 object cache
+		 */
+		void count_s3_cache(const bool n_hit) noexcept;
 
-		// CloudWatch specifically recommends to not have gaps in your values
-		// and send metrics even when nothing happened. This way your application
-		// looks alive when not busy. I will follow that advise but only for SQS messages
-		// as it seems to me sending zero render times might mess up scaling calculations
-		// along the way
-		void send_blank() noexcept;
+	private:
+		void metrics_thread() noexcept;
 
+		//! sweep the registry and send PutMetricData calls, usually one, with data for each metric
 		void send_values() noexcept;
 
 		TSharedPtr<Aws::CloudWatch::CloudWatchClient>  m_cw_client;
@@ -100,6 +109,37 @@ class UMonitoringImpl : public UObject
 		// set by thread and only accessed there, hence unprotected
 		FString                             m_instance_id;
 
-		SingleSampleQueue                   m_single_values;
-		TAtomic<unsigned int>               m_sqs_messages;
+		FMetricsRegistry                    m_registry;
+
+		// Pre-registered so recording needs no lookup
+		// Latencies are histograms so percentiles can be computed over any period
+		const FMetricHandle                 m_render_time = m_registry.register_metric(
+				"RENDER_TIME", Aws::CloudWatch::Model::StandardUnit::Milliseconds, EMetricKind::Histogram);
+		const FMetricHandle                 m_membuf_upload = m_registry.register_metric(
+				"MEMBUF_UPLOAD", Aws::CloudWatch::Model::StandardUnit::Milliseconds, EMetricKind::Histogram);
+		const FMetricHandle                 m_file_upload = m_registry.register_metric(
+				"FILE_UPLOAD", Aws::CloudWatch::Model::StandardUnit::Milliseconds, EMetricKind::Histogram);
+		const FMetricHandle                 m_s3_download = m_registry.register_metric(
+				"S3_DOWNLOAD", Aws::CloudWatch::Model::StandardUnit::Milliseconds, EMetricKind::Histogram);
+		const FMetricHandle                 m_sqs_messages = m_registry.register_metric(
+				"SQS_MESSAGES_RECEIVED", Aws::CloudWatch::Model::StandardUnit::Count, EMetricKind::Counter);
+		const FMetricHandle                 m_sqs_handler_time = m_registry.register_metric(
+				"SQS_HANDLER_TIME", Aws::CloudWatch::Model::StandardUnit::Milliseconds, EMetricKind::Histogram);
+		const FMetricHandle                 m_sqs_receive_to_ack = m_registry.register_metric(
+				"SQS_RECEIVE_TO_ACK", Aws::CloudWatch::Model::StandardUnit::Milliseconds, EMetricKind::Histogram);
+		const FMetricHandle                 m_xray_flush = m_registry.register_metric(
+				"XRAY_FLUSH", Aws::CloudWatch::Model::StandardUnit::Milliseconds, EMetricKind::Histogram);
+		const FMetricHandle                 m_log_lines_dropped = m_registry.register_metric(
+				"LOG_LINES_DROPPED", Aws::CloudWatch::Model::StandardUnit::Count, EMetricKind::Counter);
+		const FMetricHandle                 m_s3_retries = m_registry.register_metric(
+				"S3_RETRIES", Aws::CloudWatch::Model::StandardUnit::Count, EMetricKind::Counter);
+		const FMetricHandle                 m_s3_retries_denied = m_registry.register_metric(
+				"S3_RETRIES_DENIED", Aws::CloudWatch::Model::StandardUnit::Count, EMetricKind::Counter);
+		const FMetricHandle                 m_s3_cache_hits = m_registry.register_metric(
+				"S3_CACHE_HITS", Aws::CloudWatch::Model::StandardUnit::Count, EMetricKind::Counter);
+		const FMetricHandle                 m_s3_cache_misses = m_registry.register_metric(
+				"S3_CACHE_MISSES", Aws::CloudWatch::Model::StandardUnit::Count, EMetricKind::Counter);
+
+		// only accessed by thread
+		TArray<FMetricSnapshot>             m_snapshots;
 };
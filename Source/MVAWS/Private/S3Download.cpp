@@ -0,0 +1,229 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#include "S3Download.h"
+#include "S3Streams.h"
+
+#include "GenericPlatform/GenericPlatformFile.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/Paths.h"
+
+// AWS SDK
+#include "Windows/PreWindowsApi.h"
+#include <aws/core/utils/memory/AWSMemory.h>
+
+#include <aws/s3/S3Client.h>
+#include <aws/s3/model/GetObjectRequest.h>
+#include <aws/s3/model/HeadObjectRequest.h>
+#include "Windows/PostWindowsApi.h"
+
+// Std
+#include <future>
+
+using namespace Aws::S3::Model;
+
+namespace
+{
+
+/// Smallest range worth a request of its own
+constexpr uint64 s_min_part_size = 1024ull * 1024;
+
+/// One range currently being fetched
+struct range_in_flight
+{
+	int32                      m_index;
+	uint32                     m_attempt;
+	GetObjectOutcomeCallable   m_outcome;
+};
+
+} // anon ns
+
+bool head_object(Aws::S3::S3Client &n_client, const Aws::String &n_bucket, const Aws::String &n_key,
+		FS3ObjectInfo &n_info, FS3Error &n_error)
+{
+	HeadObjectRequest request;
+	request.SetBucket(n_bucket);
+	request.SetKey(n_key);
+
+	const HeadObjectOutcome outcome = n_client.HeadObject(request);
+	if (!outcome.IsSuccess())
+	{
+		n_error.set(outcome.GetError());
+		return false;
+	}
+
+	n_info.m_size = static_cast<uint64>(outcome.GetResult().GetContentLength());
+	n_info.m_etag = outcome.GetResult().GetETag();
+	return true;
+}
+
+bool ranged_download(Aws::S3::S3Client &n_client, const Aws::String &n_bucket, const Aws::String &n_key,
+		const FS3ObjectInfo &n_info, const FS3DownloadSettings &n_settings, const RangeStreamFactory &n_stream,
+		FS3RetryBudget &n_budget, FS3Error &n_error)
+{
+	if (!n_info.m_size)
+	{
+		// Nothing to fetch. An empty range would be refused anyway
+		return true;
+	}
+
+	const uint64 part_size = FMath::Max(n_settings.m_part_size, s_min_part_size);
+	const int32 num_ranges = static_cast<int32>((n_info.m_size + part_size - 1) / part_size);
+	const uint32 max_in_flight = FMath::Max(n_settings.m_parts_in_flight, 1u);
+
+	// Fires a single range off into the client's executor. The stream is created
+	// by the SDK when the response comes in. The client doesn't retry on its own,
+	// every retry of a range comes through here again after should_retry() and the shared budget
+	const auto send_range = [&](const int32 n_index, const uint32 n_attempt, range_in_flight &n_range) {
+
+		const uint64 offset = static_cast<uint64>(n_index) * part_size;
+		const uint64 size = FMath::Min(part_size, n_info.m_size - offset);
+
+		GetObjectRequest request;
+		request.SetBucket(n_bucket);
+		request.SetKey(n_key);
+		request.SetIfMatch(n_info.m_etag);
+		request.SetRange(Aws::String{ "bytes=" } + std::to_string(offset).c_str() + "-" + std::to_string(offset + size - 1).c_str());
+		request.SetResponseStreamFactory([&n_stream, offset, size]() { return n_stream(offset, size); });
+
+		if (n_attempt == 0)
+		{
+			n_budget.record_attempt();
+		}
+
+		n_range.m_index = n_index;
+		n_range.m_attempt = n_attempt;
+		n_range.m_outcome = n_client.GetObjectCallable(request);
+	};
+
+	TArray<range_in_flight> in_flight;
+	in_flight.Reserve(max_in_flight);
+
+	int32 next_range = 0;
+	bool failed = false;
+
+	while (!failed && (next_range < num_ranges || in_flight.Num()))
+	{
+		// keep the window full
+		while (next_range < num_ranges && static_cast<uint32>(in_flight.Num()) < max_in_flight)
+		{
+			range_in_flight r;
+			send_range(next_range, 0, r);
+			in_flight.Add(MoveTemp(r));
+			next_range++;
+		}
+
+		// Ranges are the same size so waiting for the oldest one
+		// is close enough to waiting for whichever finishes first
+		range_in_flight r = MoveTemp(in_flight[0]);
+		in_flight.RemoveAt(0, 1, false);
+
+		const uint64 offset = static_cast<uint64>(r.m_index) * part_size;
+		const uint64 size = FMath::Min(part_size, n_info.m_size - offset);
+
+		GetObjectOutcome outcome = r.m_outcome.get();
+		if (outcome.IsSuccess())
+		{
+			Aws::IOStream &body = outcome.GetResult().GetBody();
+			if (static_cast<uint64>(outcome.GetResult().GetContentLength()) == size && body.good())
+			{
+				body.flush();
+				if (body.good())
+				{
+					continue;
+				}
+			}
+
+			n_error.set(FString::Printf(TEXT("Range at %llu of object '%s' arrived incomplete"), offset, UTF8_TO_TCHAR(n_key.c_str())));
+		}
+		else
+		{
+			n_error.set(outcome.GetError());
+		}
+
+		if (should_retry(n_error, r.m_attempt, n_settings.m_part_retries, n_budget))
+		{
+			UE_LOG(LogMVAWS, Warning, TEXT("Range at %llu of object '%s' failed, retrying: %s"), offset,
+					UTF8_TO_TCHAR(n_key.c_str()), *n_error.m_message);
+
+			// Other ranges keep going meanwhile
+			FPlatformProcess::Sleep(backoff_delay(r.m_attempt, n_settings.m_retry_base_delay, n_settings.m_retry_max_delay));
+
+			range_in_flight retry;
+			send_range(r.m_index, r.m_attempt + 1, retry);
+			in_flight.Add(MoveTemp(retry));
+			continue;
+		}
+
+		failed = true;
+	}
+
+	// Ranges still in flight write into the caller's destination and
+	// must be done with it before we return
+	for (range_in_flight &r : in_flight)
+	{
+		r.m_outcome.wait();
+	}
+
+	return !failed;
+}
+
+bool ranged_download_to_file(Aws::S3::S3Client &n_client, const Aws::String &n_bucket, const Aws::String &n_key,
+		const FS3ObjectInfo &n_info, const FS3DownloadSettings &n_settings, const FString &n_file_path,
+		FS3RetryBudget &n_budget, FS3Error &n_error)
+{
+	IPlatformFile &platform_file = FPlatformFileManager::Get().GetPlatformFile();
+	const FString temp_path = n_file_path + TEXT(".download");
+
+	platform_file.CreateDirectoryTree(*FPaths::GetPath(n_file_path));
+	TUniquePtr<IFileHandle> handle{ platform_file.OpenWrite(*temp_path) };
+	if (!handle)
+	{
+		n_error.set(FString::Printf(TEXT("Cannot open '%s' for writing"), *temp_path));
+		return false;
+	}
+
+	// Full size up front, so ranges can be written at their offset in any order
+	const uint8 last = 0;
+	if (n_info.m_size && (!handle->Seek(static_cast<int64>(n_info.m_size) - 1) || !handle->Write(&last, 1)))
+	{
+		handle.Reset();
+		platform_file.DeleteFile(*temp_path);
+		n_error.set(FString::Printf(TEXT("Cannot allocate %llu bytes for '%s'"), n_info.m_size, *temp_path));
+		return false;
+	}
+
+	// All ranges write through the one handle. Closed before the rename
+	bool success = false;
+	{
+		FSharedWriteFile file{ MoveTemp(handle) };
+		success = ranged_download(n_client, n_bucket, n_key, n_info, n_settings,
+				[&file](const uint64 n_offset, const uint64 n_size) -> Aws::IOStream * {
+					return Aws::New<FFileRangeStream>("MVDownloadAllocationTag", file, n_offset, n_size);
+				}, n_budget, n_error);
+
+		// The range shows up as incomplete, this is why
+		if (file.failed())
+		{
+			n_error.set(FString::Printf(TEXT("Cannot write to '%s'"), *temp_path));
+			success = false;
+		}
+	}
+
+	if (!success)
+	{
+		platform_file.DeleteFile(*temp_path);
+		return false;
+	}
+
+	platform_file.DeleteFile(*n_file_path);
+	if (!platform_file.MoveFile(*n_file_path, *temp_path))
+	{
+		platform_file.DeleteFile(*temp_path);
+		n_error.set(FString::Printf(TEXT("Cannot move download to '%s'"), *n_file_path));
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,66 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#pragma once
+
+#include "CoreMinimal.h"
+#include "IMVAWS.h"
+#include "S3Impl.h"
+#include "S3Retry.h"
+
+#include "Windows/PreWindowsApi.h"
+#include <aws/core/Aws.h>
+#include <aws/core/utils/memory/stl/AWSStreamFwd.h>
+#include <aws/core/utils/memory/stl/AWSString.h>
+#include "Windows/PostWindowsApi.h"
+
+namespace Aws::S3 {
+	class S3Client;
+}
+
+/*!
+ * What we need to know about an object before fetching it
+ */
+struct FS3ObjectInfo
+{
+	uint64       m_size = 0;
+	Aws::String  m_etag;
+};
+
+/*!
+ * Called once per range (and again for each retry of that range) to get a fresh
+ * stream receiving the bytes [n_offset, n_offset + n_size) of the object.
+ * Must be created with Aws::New, the SDK takes ownership. Called on the SDK's threads.
+ * A stream that is bad already or fails on writing fails the range.
+ */
+using RangeStreamFactory = TFunction<Aws::IOStream *(const uint64 n_offset, const uint64 n_size)>;
+
+/*!
+ * HeadObject for size and ETag. Blocking
+ */
+bool head_object(Aws::S3::S3Client &n_client, const Aws::String &n_bucket, const Aws::String &n_key,
+		FS3ObjectInfo &n_info, FS3Error &n_error);
+
+/*!
+ * Download the object in byte ranges of n_settings.m_part_size, up to m_parts_in_flight
+ * of them at once using the client's executor. Each range goes straight into the stream
+ * n_stream gives for it and is retried on its own.
+ * All ranges ask for n_info's ETag, so a changed object fails the download instead of
+ * mixing versions.
+ * Blocks until done.
+ * \return true when all ranges arrived in full
+ */
+bool ranged_download(Aws::S3::S3Client &n_client, const Aws::String &n_bucket, const Aws::String &n_key,
+		const FS3ObjectInfo &n_info, const FS3DownloadSettings &n_settings, const RangeStreamFactory &n_stream,
+		FS3RetryBudget &n_budget, FS3Error &n_error);
+
+/*!
+ * ranged_download() into n_file_path. The ranges go into a file of the object's size
+ * next to it, each written at its offset through the one handle to that file, which is
+ * renamed to n_file_path when complete. n_file_path is replaced if it exists.
+ * Blocks until done.
+ */
+bool ranged_download_to_file(Aws::S3::S3Client &n_client, const Aws::String &n_bucket, const Aws::String &n_key,
+		const FS3ObjectInfo &n_info, const FS3DownloadSettings &n_settings, const FString &n_file_path,
+		FS3RetryBudget &n_budget, FS3Error &n_error);
@@ -3,13 +3,22 @@
  * See attached file LICENSE for full details
  */
 #include "S3Impl.h"
+#include "S3Multipart.h"
+#include "S3Download.h"
+#include "S3ObjectCache.h"
+#include "S3Streams.h"
+#include "S3UploadJournal.h"
 #include "Utils.h"
 
 // Engine
+#include "Async/Async.h"
 #include "Async/AsyncWork.h"
 #include "Async/TaskGraphInterfaces.h"
+#include "Async/MappedFileHandle.h"
 #include "GenericPlatform/GenericPlatformFile.h"
 #include "HAL/PlatformFilemanager.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
 
 // AWS SDK
 #include "Windows/PreWindowsApi.h"
@@ -21,27 +30,216 @@
 #include <aws/core/utils/logging/AWSLogging.h>
 #include <aws/core/utils/logging/DefaultLogSystem.h>
 #include <aws/core/auth/AWSCredentialsProvider.h>
+#include <aws/core/auth/AWSAuthSigner.h>
+#include <aws/core/utils/threading/Executor.h>
+#include <aws/core/client/DefaultRetryStrategy.h>
 
 #include <aws/s3/S3Client.h>
 #include <aws/s3/model/PutObjectRequest.h>
 #include <aws/s3/model/PutObjectResult.h>
+#include <aws/s3/model/HeadBucketRequest.h>
 #include "Windows/PostWindowsApi.h"
 
 // Std
 #include <iostream>
 #include <memory>
-#include <strstream>
 #include <fstream>
 
 using namespace Aws::S3::Model;
 
-/** I'm trying to switch to a globally used client object here as well as
- *  AWS docs state that those objects are threadsafe.
+namespace 
+{
+
+/** @brief Create the S3 client all uploads share. AWS docs state that those objects are threadsafe.
+ *
+ *  Normally I would specify a credentials profile to use like this:
+ *
+ *	Aws::Client::ClientConfiguration client_config(TCHAR_TO_ANSI(*m_profile));
+ *	client_config.region = "eu-central-1";
+ *	Aws::S3::S3Client s3(client_config);
+ *
+ *  However, this doesn't seem to work. It always chooses default profile.
+ *  Instead, setting an environment variable called AWS_PROFILE to the 
+ *  desired profile will do the trick.
+ *  I have removed profile selection as a consequence.
+ *  Most likely a bug but not really relevant for live cases as this will generally
+ *  use the role attached to the instance.
  */
-static TUniquePtr<Aws::S3::S3Client> s_s3_client;
+S3ClientPtr create_client(const FS3ClientSettings &n_settings)
+{
+	Aws::Client::ClientConfiguration client_config;
+	client_config.enableEndpointDiscovery = use_endpoint_discovery();
+	const FString s3_endpoint = readenv(TEXT("MVAWS_S3_ENDPOINT"));
+	if (!s3_endpoint.IsEmpty())
+	{
+		client_config.endpointOverride = TCHAR_TO_UTF8(*s3_endpoint);
+	}
 
-namespace 
+	client_config.maxConnections = FMath::Max(n_settings.m_max_connections, 1u);
+	client_config.connectTimeoutMs = n_settings.m_connect_timeout_ms;
+	client_config.requestTimeoutMs = n_settings.m_request_timeout_ms;
+	client_config.enableTcpKeepAlive = n_settings.m_tcp_keep_alive;
+	client_config.tcpKeepAliveIntervalMs = n_settings.m_tcp_keep_alive_interval_ms;
+
+	// Multipart parts are sent through the client's executor. The default one
+	// spawns a thread per call, a pool the size of the connection pool scales better
+	client_config.executor = Aws::MakeShared<Aws::Utils::Threading::PooledThreadExecutor>("s3", client_config.maxConnections);
+
+	// Retries are ours, see S3Retry.h. The SDK's own would retry every request up to 10 times
+	// on top of them, unseen by the retry budget and metrics
+	client_config.retryStrategy = Aws::MakeShared<Aws::Client::DefaultRetryStrategy>("s3", 0);
+
+	return MakeShareable<Aws::S3::S3Client>(new Aws::S3::S3Client(client_config,
+			Aws::Client::AWSAuthV4Signer::PayloadSigningPolicy::Never, !s3_use_path_style()));
+}
+
+/** @brief Open n_count connections to the bucket's endpoint in the background.
+ *  A bunch of concurrent HeadBucket calls does the handshakes, afterwards the connections
+ *  stay in the client's pool. Nobody waits for the outcome, failures are just logged.
+ */
+void prewarm_client(const S3ClientPtr &n_client, const FString &n_bucket_name, const uint32 n_count)
+{
+	if (!n_client || n_bucket_name.IsEmpty() || !n_count)
+	{
+		return;
+	}
+
+	HeadBucketRequest request;
+	request.SetBucket(TCHAR_TO_UTF8(*n_bucket_name));
+
+	for (uint32 i = 0; i < n_count; i++)
+	{
+		n_client->HeadBucketAsync(request, [](const Aws::S3::S3Client *, const HeadBucketRequest &,
+				const HeadBucketOutcome &n_outcome, const std::shared_ptr<const Aws::Client::AsyncCallerContext> &) {
+
+			if (!n_outcome.IsSuccess())
+			{
+				UE_LOG(LogMVAWS, Verbose, TEXT("S3 connection prewarm failed: %s"), UTF8_TO_TCHAR(n_outcome.GetError().GetMessage().c_str()));
+			}
+		});
+	}
+
+	UE_LOG(LogMVAWS, Display, TEXT("Prewarming %u S3 connections to bucket '%s'"), n_count, *n_bucket_name);
+}
+
+/** @brief Tell the caller about the result of an upload.
+ *  If we have a completion handler, execute it on the game thread like guaranteed in the interface.
+ *  Otherwise issue the result directly to the logs
+ */
+void report_upload_result(const bool n_success, const FString &n_error, const FS3UploadTarget &n_target,
+		const FOnCacheUploadFinished &n_completion)
 {
+	if (n_completion.IsBound()) 
+	{
+		FGraphEventRef game_thread_task
+				= FFunctionGraphTask::CreateAndDispatchWhenReady([n_success, n_error, handler{ n_completion }, object_key{ n_target.ObjectKey }] {
+			
+			if (n_success) 
+			{
+				UE_LOG(LogMVAWS, Display, TEXT("Upload of object '%s' complete"), *object_key);
+				handler.Execute(true, object_key);
+			} 
+			else 
+			{
+				UE_LOG(LogMVAWS, Error, TEXT("Upload of object '%s' failed: %s"), *object_key, *n_error);
+				handler.Execute(false, object_key);
+			}
+			
+		}, TStatId(), NULL, ENamedThreads::GameThread);
+	} 
+	else 
+	{
+		if (!n_success) 
+		{
+			UE_LOG(LogMVAWS, Error, TEXT("Upload of object '%s' to bucket '%s' failed: %s"), *n_target.ObjectKey, *n_target.BucketName, *n_error);
+		} 
+		else 
+		{
+			UE_LOG(LogMVAWS, Display, TEXT("Upload of object '%s' to bucket '%s' complete"), *n_target.ObjectKey, *n_target.BucketName);
+		}
+	}
+}
+
+/** @brief Upload a payload that is readable in memory, be it our own buffer or a mapped file.
+ *  Goes multipart above the threshold, otherwise a single PutObject.
+ *  Every body is a read-only view into n_data, nothing is copied. n_data must outlive the call.
+ *  n_journal, if given, makes a multipart upload resumable.
+ */
+bool upload_from_memory(Aws::S3::S3Client &n_client, const FS3UploadTarget &n_target,
+		const unsigned char *n_data, const uint64 n_size, const FS3UploadSettings &n_settings,
+		FS3RetryBudget &n_budget, FS3Error &n_error, FS3UploadJournal *n_journal = nullptr)
+{
+	if (n_size > n_settings.m_multipart_threshold)
+	{
+		// Large payloads go in parts, several at a time
+		return multipart_upload(n_client, n_target, n_size, n_settings,
+			[n_data](const uint64 n_offset, const uint64 n_part_size) -> std::shared_ptr<Aws::IOStream> {
+				return Aws::MakeShared<FReadOnlyMemoryStream>("MVAllocationTag", n_data + n_offset, n_part_size);
+			}, n_budget, n_error, n_journal);
+	}
+
+	PutObjectRequest request;
+	request.SetBucket(TCHAR_TO_ANSI(*n_target.BucketName));
+	request.SetKey(TCHAR_TO_ANSI(*n_target.ObjectKey));
+	request.SetContentType(TCHAR_TO_ANSI(*n_target.ContentType));
+
+	// A read-only stream directly over the memory, no copy. Sadly, the SDK
+	// needs this to be an IOStream even though there's no modifying it.
+	// Giving the length right away saves the SDK from seeking around to find it
+	std::shared_ptr<Aws::IOStream> input_data =
+		Aws::MakeShared<FReadOnlyMemoryStream>("MVAllocationTag", n_data, n_size);
+
+	request.SetContentLength(static_cast<long long>(n_size));
+	request.SetBody(input_data);
+
+	// issue the put request
+	const PutObjectOutcome outcome = n_client.PutObject(request);
+	if (!outcome.IsSuccess())
+	{
+		n_error.set(outcome.GetError());
+		return false;
+	}
+
+	return true;
+}
+
+/** @brief Run a transfer until it succeeds, fails in a way another try won't fix,
+ *  or the retries are used up, either its own or the budget all transfers share.
+ *  Waits with backoff and jitter between attempts, so throttled transfers don't come back all at once.
+ *  @param n_what "Upload" or "Download", for the log
+ */
+bool with_retries(const TCHAR *n_what, const FString &n_object_key, const uint32 n_retries,
+		const float n_base_delay, const float n_max_delay, FS3RetryBudget &n_budget, FS3Error &n_error,
+		const TFunctionRef<bool (FS3Error &)> &n_transfer)
+{
+	n_budget.record_attempt();
+
+	for (uint32 attempt = 0; ; attempt++)
+	{
+		n_error = FS3Error{};
+		if (n_transfer(n_error))
+		{
+			return true;
+		}
+
+		if (!should_retry(n_error, attempt, n_retries, n_budget))
+		{
+			return false;
+		}
+
+		const float delay = backoff_delay(attempt, n_base_delay, n_max_delay);
+		UE_LOG(LogMVAWS, Warning, TEXT("%s of object '%s' failed, retrying in %.1f seconds: %s"),
+				n_what, *n_object_key, delay, *n_error.m_message);
+		FPlatformProcess::Sleep(delay);
+	}
+}
+
+bool upload_with_retries(const FS3UploadTarget &n_target, const FS3UploadSettings &n_settings,
+		FS3RetryBudget &n_budget, FS3Error &n_error, const TFunctionRef<bool (FS3Error &)> &n_upload)
+{
+	return with_retries(TEXT("Upload"), n_target.ObjectKey, n_settings.m_upload_retries,
+			n_settings.m_retry_base_delay, n_settings.m_retry_max_delay, n_budget, n_error, n_upload);
+}
 
 /** @brief An asynchronous task which will take care of uploading the S3 data in a queued thread pool
 	This is a simple form of such a task and only meant to make S3 uploads fire and forget
@@ -59,12 +257,20 @@ class MembufUploadAsyncTask : public FNonAbandonableTask
 						TUniquePtr<unsigned char []> &&n_data,
 						const size_t n_size,
 						const FString n_trace_id,
-						const FOnCacheUploadFinished n_completion)
+						const FOnCacheUploadFinished n_completion,
+						const FS3UploadSettings &n_settings,
+						const S3ClientPtr &n_client,
+						const S3RetryBudgetPtr &n_budget,
+						FS3UploadScheduler *n_scheduler)
 				: m_target{ n_target }
 				, m_data{ MoveTemp(n_data) }
 				, m_size{ n_size }
 				, m_trace_id{ n_trace_id }
-				, m_completion_delegate{ n_completion } {}
+				, m_completion_delegate{ n_completion }
+				, m_settings{ n_settings }
+				, m_client{ n_client }
+				, m_budget{ n_budget }
+				, m_scheduler{ n_scheduler } {}
 
 		void DoWork() 
 		{
@@ -75,77 +281,20 @@ class MembufUploadAsyncTask : public FNonAbandonableTask
 				subseg_id = IMVAWSModule::Get().start_trace_subsegment(m_trace_id, TEXT("S3Upload"));
 			}
 
-			// Normally I would specify a credentials profile to use like this:
-			//
-			//	Aws::Client::ClientConfiguration client_config(TCHAR_TO_ANSI(*m_profile));
-			//	client_config.region = "eu-central-1";
-			//	Aws::S3::S3Client s3(client_config);
-			//
-			// However, this doesn't seem to work. It always chooses default profile.
-			// Instead, setting an environment variable called AWS_PROFILE to the 
-			// desired profile will do the trick.
-			// I have removed profile selection as a consequence.
-			// Most likely a bug but not really relevant for live cases as this will generally
-			// use the role attached to the instance.
-		
 			UE_LOG(LogMVAWS, Display, TEXT("Starting upload"));
 
-			// Create a S3 client object and assemble request
-			if (!s_s3_client) {
-				s_s3_client = MakeUnique<Aws::S3::S3Client>();
-			}
+			// The buffer stays ours until the last attempt is through
+			FS3Error error;
+			const bool success = upload_with_retries(m_target, m_settings, *m_budget, error, [this](FS3Error &n_error) {
+				return upload_from_memory(*m_client, m_target, m_data.Get(), m_size, m_settings, *m_budget, n_error);
+			});
 
-			PutObjectRequest request;
-			request.SetBucket(TCHAR_TO_ANSI(*m_target.BucketName));
-			request.SetKey(TCHAR_TO_ANSI(*m_target.ObjectKey));
-			request.SetContentType(TCHAR_TO_ANSI(*m_target.ContentType));
+			// The buffer is not needed anymore. Free it right away and give back
+			// its share of the budget so waiting uploads can go ahead
+			m_data.Reset();
+			m_scheduler->release(m_size);
 
-			// Create a streambuf wrapper around our buffer without copying it
-			std::strstreambuf sbuf{ m_data.Get(), static_cast<std::streamsize>(m_size) };
-
-			// And a stream to read from it. Sadly, this needs to be an IOStream 
-			// even though there's no modifying it
-			std::shared_ptr<Aws::IOStream> input_data =
-				Aws::MakeShared<Aws::IOStream>("MVAllocationTag", &sbuf);
-
-			request.SetBody(input_data);
-
-			// issue the put request
-			const PutObjectOutcome outcome = s_s3_client->PutObject(request);
-
-			// If we have a completion handler, execute it on the game thread like guaranteed in the interface
-			if (m_completion_delegate.IsBound()) 
-			{
-			
-				FGraphEventRef game_thread_task
-						= FFunctionGraphTask::CreateAndDispatchWhenReady([outcome, handler{this->m_completion_delegate}, object_key{ this->m_target.ObjectKey }] {
-					
-					if (outcome.IsSuccess()) 
-					{
-						UE_LOG(LogMVAWS, Display, TEXT("Upload of object '%s' complete"), *object_key);
-						handler.Execute(true, object_key);
-					} 
-					else 
-					{
-						UE_LOG(LogMVAWS, Error, TEXT("Upload of object '%s' failed: %s"), *object_key,
-								UTF8_TO_TCHAR(outcome.GetError().GetMessage().c_str()));
-						handler.Execute(false, object_key);
-					}
-					
-				}, TStatId(), NULL, ENamedThreads::GameThread);
-			} else 
-			{
-				// Otherwise issue the error directly to the logs
-				if (!outcome.IsSuccess()) 
-				{
-					UE_LOG(LogMVAWS, Error, TEXT("Upload of object '%s' to bucket '%s' failed: %s"), *m_target.ObjectKey, *m_target.BucketName,
-							UTF8_TO_TCHAR(outcome.GetError().GetMessage().c_str()));
-				} 
-				else 
-				{
-					UE_LOG(LogMVAWS, Display, TEXT("Upload of object '%s' to bucket '%s' complete"), *m_target.ObjectKey, *m_target.BucketName);
-				}
-			}
+			report_upload_result(success, error.m_message, m_target, m_completion_delegate);
 
 			// begin x-ray trace of this command. This is called a subsegment, which is later assembled to a segment
 			if (!subseg_id.IsEmpty()) 
@@ -166,10 +315,14 @@ class MembufUploadAsyncTask : public FNonAbandonableTask
 		friend class FAutoDeleteAsyncTask<MembufUploadAsyncTask>;
 
 		const FS3UploadTarget              m_target;
-		const TUniquePtr<unsigned char []> m_data;
+		TUniquePtr<unsigned char []>       m_data;
 		const size_t                       m_size;
 		const FString                      m_trace_id;
 		const FOnCacheUploadFinished       m_completion_delegate;
+		const FS3UploadSettings            m_settings;
+		const S3ClientPtr                  m_client;
+		const S3RetryBudgetPtr             m_budget;
+		FS3UploadScheduler * const         m_scheduler;    //!< outlives all tasks
 };
 
 
@@ -184,11 +337,17 @@ class FileUploadAsyncTask : public FNonAbandonableTask
 		FileUploadAsyncTask(const FS3UploadTarget &n_target,
 						const FString n_file_path,
 						const FString n_trace_id,
-						const FOnCacheUploadFinished n_completion)
+						const FOnCacheUploadFinished n_completion,
+						const FS3UploadSettings &n_settings,
+						const S3ClientPtr &n_client,
+						const S3RetryBudgetPtr &n_budget)
 				: m_target{ n_target }
 				, m_file_path{ n_file_path }
 				, m_trace_id{ n_trace_id }
-				, m_completion_delegate{ n_completion } {}
+				, m_completion_delegate{ n_completion }
+				, m_settings{ n_settings }
+				, m_client{ n_client }
+				, m_budget{ n_budget } {}
 
 		void DoWork()
 		{
@@ -202,9 +361,85 @@ class FileUploadAsyncTask : public FNonAbandonableTask
 
 			UE_LOG(LogMVAWS, Display, TEXT("Starting upload"));
 
-			// Create a S3 client object and assemble request
-			if (!s_s3_client) {
-				s_s3_client = MakeUnique<Aws::S3::S3Client>();
+			// Map the file read-only and send it straight from the page cache.
+			// Size probe, checksum and sending all read the same pages, no copies through iostreams.
+			// Region must go before the handle, hence the declaration order
+			IPlatformFile &platform_file = FPlatformFileManager::Get().GetPlatformFile();
+			TUniquePtr<IMappedFileHandle> mapped_file{ platform_file.OpenMapped(*m_file_path) };
+			TUniquePtr<IMappedFileRegion> mapped_region;
+			if (mapped_file && mapped_file->GetFileSize() > 0)
+			{
+				mapped_region.Reset(mapped_file->MapRegion(0, mapped_file->GetFileSize()));
+			}
+
+			if (!mapped_region)
+			{
+				UE_LOG(LogMVAWS, Verbose, TEXT("Cannot map '%s', reading it instead"), *m_file_path);
+			}
+
+			// Multipart uploads are recorded so they continue where they failed,
+			// with the next attempt or after a restart, instead of starting over
+			TUniquePtr<FS3UploadJournal> journal;
+			const int64 file_size = platform_file.FileSize(*m_file_path);
+			if (!m_settings.m_journal_directory.IsEmpty() && file_size > 0
+					&& static_cast<uint64>(file_size) > m_settings.m_multipart_threshold)
+			{
+				journal = MakeUnique<FS3UploadJournal>(m_settings.m_journal_directory, m_target, m_file_path, m_settings.m_journal_ttl);
+			}
+
+			FS3Error error;
+			const bool success = upload_with_retries(m_target, m_settings, *m_budget, error, [&](FS3Error &n_error) {
+				if (mapped_region)
+				{
+					return upload_from_memory(*m_client, m_target, mapped_region->GetMappedPtr(),
+							static_cast<uint64>(mapped_region->GetMappedSize()), m_settings, *m_budget, n_error, journal.Get());
+				}
+
+				return upload_read(platform_file, n_error, journal.Get());
+			});
+
+			report_upload_result(success, error.m_message, m_target, m_completion_delegate);
+
+			// begin x-ray trace of this command. This is called a subsegment, which is later assembled to a segment
+			if (!subseg_id.IsEmpty())
+			{
+				IMVAWSModule::Get().end_trace_subsegment(m_trace_id, subseg_id);
+			}
+
+			const long long end_time = epoch_milliseconds();
+			IMVAWSModule::Get().count_file_upload(static_cast<float>(end_time - start_time));
+		}
+
+		FORCEINLINE TStatId GetStatId() const
+		{
+			RETURN_QUICK_DECLARE_CYCLE_STAT(FileUploadAsyncTask, STATGROUP_ThreadPoolAsyncTasks);
+		}
+
+		/// Fallback for when the platform can't map files (or that particular one)
+		bool upload_read(IPlatformFile &n_platform_file, FS3Error &n_error, FS3UploadJournal *n_journal)
+		{
+			const int64 file_size = n_platform_file.FileSize(*m_file_path);
+
+			if (file_size > 0 && static_cast<uint64>(file_size) > m_settings.m_multipart_threshold)
+			{
+				// Parts are requested one after the other on this thread, so one
+				// handle is enough. Each part reads its own range into a buffer owned by the part
+				TUniquePtr<IFileHandle> file{ n_platform_file.OpenRead(*m_file_path) };
+				if (!file)
+				{
+					n_error.set(FString::Printf(TEXT("Cannot open '%s'"), *m_file_path));
+					return false;
+				}
+
+				return multipart_upload(*m_client, m_target, file_size, m_settings,
+					[&file](const uint64 n_offset, const uint64 n_size) -> std::shared_ptr<Aws::IOStream> {
+						TUniquePtr<unsigned char []> part = MakeUnique<unsigned char []>(n_size);
+						if (!file->Seek(static_cast<int64>(n_offset)) || !file->Read(part.Get(), static_cast<int64>(n_size)))
+						{
+							return nullptr;
+						}
+						return Aws::MakeShared<FReadOnlyMemoryStream>("MVFileAllocationTag", MoveTemp(part), n_size);
+					}, *m_budget, n_error, n_journal);
 			}
 
 			PutObjectRequest request;
@@ -219,109 +454,511 @@ class FileUploadAsyncTask : public FNonAbandonableTask
 			request.SetBody(input_data);
 
 			// issue the put request
-			const PutObjectOutcome outcome = s_s3_client->PutObject(request);
+			const PutObjectOutcome outcome = m_client->PutObject(request);
+			if (!outcome.IsSuccess())
+			{
+				n_error.set(outcome.GetError());
+				return false;
+			}
+
+			return true;
+		}
+
+	private:
+		friend class FAutoDeleteAsyncTask<FileUploadAsyncTask>;
+
+		const FS3UploadTarget         m_target;
+		const FString                 m_file_path;
+		const FString                 m_trace_id;
+		const FOnCacheUploadFinished  m_completion_delegate;
+		const FS3UploadSettings       m_settings;
+		const S3ClientPtr             m_client;
+		const S3RetryBudgetPtr        m_budget;
+};
+
+/** @brief Fetches an object from S3 into memory or a file in the upload pool.
+	Like the upload tasks, fire and forget. The result goes to the delegate on the game thread.
+ */
+class DownloadAsyncTask : public FNonAbandonableTask
+{
+	private:
+		DownloadAsyncTask() = delete;
+		DownloadAsyncTask(const DownloadAsyncTask &) = delete;
+		DownloadAsyncTask(DownloadAsyncTask &&) = default;
+
+		/// To memory
+		DownloadAsyncTask(const FS3DownloadSource &n_source,
+						const FString n_trace_id,
+						const FOnCacheDownloadFinished n_completion,
+						const FS3DownloadSettings &n_settings,
+						const S3ClientPtr &n_client,
+						const S3RetryBudgetPtr &n_budget)
+				: m_source{ n_source }
+				, m_trace_id{ n_trace_id }
+				, m_completion_delegate{ n_completion }
+				, m_settings{ n_settings }
+				, m_client{ n_client }
+				, m_budget{ n_budget } {}
+
+		/// To file
+		DownloadAsyncTask(const FS3DownloadSource &n_source,
+						const FString n_file_path,
+						const FString n_trace_id,
+						const FOnCacheDownloadToFileFinished n_completion,
+						const FS3DownloadSettings &n_settings,
+						const S3ClientPtr &n_client,
+						const S3RetryBudgetPtr &n_budget)
+				: m_source{ n_source }
+				, m_file_path{ n_file_path }
+				, m_trace_id{ n_trace_id }
+				, m_file_completion_delegate{ n_completion }
+				, m_settings{ n_settings }
+				, m_client{ n_client }
+				, m_budget{ n_budget } {}
+
+		void DoWork()
+		{
+			const long long start_time = epoch_milliseconds();
+
+			FString subseg_id;
+			if (!m_trace_id.IsEmpty()) {
+				subseg_id = IMVAWSModule::Get().start_trace_subsegment(m_trace_id, TEXT("S3Download"));
+			}
+
+			FS3Error error;
+			FS3DownloadBuffer data;
+			const bool success = with_retries(TEXT("Download"), m_source.ObjectKey, m_settings.m_retries,
+					m_settings.m_retry_base_delay, m_settings.m_retry_max_delay, *m_budget, error, [&](FS3Error &n_error) {
+				return m_file_path.IsEmpty() ? download_to_memory(data, n_error) : download_to_file(n_error);
+			});
+
+			if (success)
+			{
+				UE_LOG(LogMVAWS, Display, TEXT("Download of object '%s' from bucket '%s' complete"), *m_source.ObjectKey, *m_source.BucketName);
+			}
+			else
+			{
+				UE_LOG(LogMVAWS, Error, TEXT("Download of object '%s' from bucket '%s' failed: %s"), *m_source.ObjectKey,
+						*m_source.BucketName, *error.m_message);
+			}
 
-			// If we have a completion handler, execute it on the game thread like guaranteed in the interface
 			if (m_completion_delegate.IsBound())
 			{
+				FFunctionGraphTask::CreateAndDispatchWhenReady([success, handler{ m_completion_delegate }, object_key{ m_source.ObjectKey }, data] {
+					handler.Execute(success, object_key, data);
+				}, TStatId(), NULL, ENamedThreads::GameThread);
+			}
+			else if (m_file_completion_delegate.IsBound())
+			{
+				FFunctionGraphTask::CreateAndDispatchWhenReady([success, handler{ m_file_completion_delegate }, object_key{ m_source.ObjectKey }] {
+					handler.Execute(success, object_key);
+				}, TStatId(), NULL, ENamedThreads::GameThread);
+			}
+
+			if (!subseg_id.IsEmpty())
+			{
+				IMVAWSModule::Get().end_trace_subsegment(m_trace_id, subseg_id, !success);
+			}
 
-				FGraphEventRef game_thread_task
-					= FFunctionGraphTask::CreateAndDispatchWhenReady(
-						[outcome, handler{ this->m_completion_delegate }, object_key{ this->m_target.ObjectKey }]{
-
-					if (outcome.IsSuccess())
-					{
-						UE_LOG(LogMVAWS, Display, TEXT("Upload of object '%s' complete"), *object_key);
-						handler.Execute(true, object_key);
-					}
-					else
-					{
-						UE_LOG(LogMVAWS, Error, TEXT("Upload of object '%s' failed: %s"), *object_key,
-								UTF8_TO_TCHAR(outcome.GetError().GetMessage().c_str()));
-						handler.Execute(false, object_key);
-					}
+			const long long end_time = epoch_milliseconds();
+			IMVAWSModule::Get().count_download(static_cast<float>(end_time - start_time));
+		}
+
+		FORCEINLINE TStatId GetStatId() const
+		{
+			RETURN_QUICK_DECLARE_CYCLE_STAT(DownloadAsyncTask, STATGROUP_ThreadPoolAsyncTasks);
+		}
+
+		/// One buffer the size of the object, ranges are received right into it
+		bool download_to_memory(FS3DownloadBuffer &n_data, FS3Error &n_error)
+		{
+			const Aws::String bucket{ TCHAR_TO_UTF8(*m_source.BucketName) };
+			const Aws::String key{ TCHAR_TO_UTF8(*m_source.ObjectKey) };
+
+			FS3ObjectInfo info;
+			if (!head_object(*m_client, bucket, key, info, n_error))
+			{
+				return false;
+			}
+
+			n_data = MakeShared<TArray64<uint8>, ESPMode::ThreadSafe>();
+			n_data->SetNumUninitialized(static_cast<int64>(info.m_size));
+			uint8 *destination = n_data->GetData();
+
+			if (!ranged_download(*m_client, bucket, key, info, m_settings,
+					[destination](const uint64 n_offset, const uint64 n_size) -> Aws::IOStream * {
+						return Aws::New<FMemoryRangeStream>("MVDownloadAllocationTag", destination + n_offset, n_size);
+					}, *m_budget, n_error))
+			{
+				n_data.Reset();
+				return false;
+			}
+
+			return true;
+		}
+
+		/// Into a file next to the destination, renamed when complete
+		bool download_to_file(FS3Error &n_error)
+		{
+			const Aws::String bucket{ TCHAR_TO_UTF8(*m_source.BucketName) };
+			const Aws::String key{ TCHAR_TO_UTF8(*m_source.ObjectKey) };
+
+			FS3ObjectInfo info;
+			if (!head_object(*m_client, bucket, key, info, n_error))
+			{
+				return false;
+			}
+
+			return ranged_download_to_file(*m_client, bucket, key, info, m_settings, m_file_path, *m_budget, n_error);
+		}
 
+	private:
+		friend class FAutoDeleteAsyncTask<DownloadAsyncTask>;
+
+		const FS3DownloadSource               m_source;
+		const FString                         m_file_path;     //!< empty when downloading to memory
+		const FString                         m_trace_id;
+		const FOnCacheDownloadFinished        m_completion_delegate;
+		const FOnCacheDownloadToFileFinished  m_file_completion_delegate;
+		const FS3DownloadSettings             m_settings;
+		const S3ClientPtr                     m_client;
+		const S3RetryBudgetPtr                m_budget;
+};
+
+/** @brief Gets an object through the object cache: validates the ETag of what we have with S3
+	and serves it mapped, or downloads the object into the cache and serves that.
+ */
+class CachedDownloadAsyncTask : public FNonAbandonableTask
+{
+	private:
+		CachedDownloadAsyncTask() = delete;
+		CachedDownloadAsyncTask(const CachedDownloadAsyncTask &) = delete;
+		CachedDownloadAsyncTask(CachedDownloadAsyncTask &&) = default;
+
+		CachedDownloadAsyncTask(const FS3DownloadSource &n_source,
+						const FString n_trace_id,
+						const FOnCachedDownloadFinished n_completion,
+						const FS3DownloadSettings &n_settings,
+						const S3ClientPtr &n_client,
+						const S3RetryBudgetPtr &n_budget,
+						const S3ObjectCachePtr &n_cache)
+				: m_source{ n_source }
+				, m_trace_id{ n_trace_id }
+				, m_completion_delegate{ n_completion }
+				, m_settings{ n_settings }
+				, m_client{ n_client }
+				, m_budget{ n_budget }
+				, m_cache{ n_cache } {}
+
+		void DoWork()
+		{
+			const long long start_time = epoch_milliseconds();
+
+			FString subseg_id;
+			if (!m_trace_id.IsEmpty()) {
+				subseg_id = IMVAWSModule::Get().start_trace_subsegment(m_trace_id, TEXT("S3CachedDownload"));
+			}
+
+			FS3Error error;
+			FS3CachedObjectPtr object;
+			bool downloaded = false;
+			const bool success = with_retries(TEXT("Download"), m_source.ObjectKey, m_settings.m_retries,
+					m_settings.m_retry_base_delay, m_settings.m_retry_max_delay, *m_budget, error, [&](FS3Error &n_error) {
+				return fetch(object, downloaded, n_error);
+			});
+
+			if (!success)
+			{
+				UE_LOG(LogMVAWS, Error, TEXT("Download of object '%s' from bucket '%s' failed: %s"), *m_source.ObjectKey,
+						*m_source.BucketName, *error.m_message);
+			}
+
+			if (m_completion_delegate.IsBound())
+			{
+				FFunctionGraphTask::CreateAndDispatchWhenReady([success, handler{ m_completion_delegate }, object_key{ m_source.ObjectKey }, object] {
+					handler.Execute(success, object_key, object);
 				}, TStatId(), NULL, ENamedThreads::GameThread);
 			}
-			else
+
+			// Let go of our reference here rather than in the delegate's
+			object.Reset();
+
+			if (!subseg_id.IsEmpty())
+			{
+				IMVAWSModule::Get().end_trace_subsegment(m_trace_id, subseg_id, !success);
+			}
+
+			if (success)
+			{
+				IMVAWSModule::Get().count_s3_cache(!downloaded);
+			}
+
+			if (downloaded)
+			{
+				const long long end_time = epoch_milliseconds();
+				IMVAWSModule::Get().count_download(static_cast<float>(end_time - start_time));
+			}
+		}
+
+		FORCEINLINE TStatId GetStatId() const
+		{
+			RETURN_QUICK_DECLARE_CYCLE_STAT(CachedDownloadAsyncTask, STATGROUP_ThreadPoolAsyncTasks);
+		}
+
+		bool fetch(FS3CachedObjectPtr &n_object, bool &n_downloaded, FS3Error &n_error)
+		{
+			Aws::String etag;
+			bool fresh = false;
+			const bool cached = m_cache->lookup(m_source, etag, fresh);
+
+			if (cached && fresh)
 			{
-				// Otherwise issue the error directly to the logs
-				if (!outcome.IsSuccess())
+				n_object = m_cache->open(m_source, etag, false);
+				if (n_object)
 				{
-					UE_LOG(LogMVAWS, Error, TEXT("Upload of object '%s' to bucket '%s' failed: %s"), *m_target.ObjectKey, *m_target.BucketName,
-						UTF8_TO_TCHAR(outcome.GetError().GetMessage().c_str()));
+					return true;
 				}
-				else
+			}
+
+			// Revalidation and download both need size and ETag
+			const Aws::String bucket{ TCHAR_TO_UTF8(*m_source.BucketName) };
+			const Aws::String key{ TCHAR_TO_UTF8(*m_source.ObjectKey) };
+
+			FS3ObjectInfo info;
+			if (!head_object(*m_client, bucket, key, info, n_error))
+			{
+				return false;
+			}
+
+			if (cached && info.m_etag == etag)
+			{
+				n_object = m_cache->open(m_source, etag, true);
+				if (n_object)
 				{
-					UE_LOG(LogMVAWS, Display, TEXT("Upload of object '%s' to bucket '%s' complete"), *m_target.ObjectKey, *m_target.BucketName);
+					return true;
 				}
 			}
 
-			// begin x-ray trace of this command. This is called a subsegment, which is later assembled to a segment
-			if (!subseg_id.IsEmpty())
+			const FString temp_path = m_cache->temp_path();
+			if (!ranged_download_to_file(*m_client, bucket, key, info, m_settings, temp_path, *m_budget, n_error))
 			{
-				IMVAWSModule::Get().end_trace_subsegment(m_trace_id, subseg_id);
+				return false;
 			}
 
-			const long long end_time = epoch_milliseconds();
-			IMVAWSModule::Get().count_file_upload(static_cast<float>(end_time - start_time));
-		}
+			n_downloaded = true;
+			n_object = m_cache->insert(m_source, info.m_etag, temp_path);
+			if (!n_object)
+			{
+				n_error.set(FString::Printf(TEXT("Cannot add object '%s' to the cache"), *m_source.ObjectKey));
+				return false;
+			}
 
-		FORCEINLINE TStatId GetStatId() const
-		{
-			RETURN_QUICK_DECLARE_CYCLE_STAT(FileUploadAsyncTask, STATGROUP_ThreadPoolAsyncTasks);
+			UE_LOG(LogMVAWS, Display, TEXT("Download of object '%s' from bucket '%s' into cache complete"), *m_source.ObjectKey,
+					*m_source.BucketName);
+			return true;
 		}
 
 	private:
-		friend class FAutoDeleteAsyncTask<FileUploadAsyncTask>;
+		friend class FAutoDeleteAsyncTask<CachedDownloadAsyncTask>;
 
-		const FS3UploadTarget         m_target;
-		const FString                 m_file_path;
-		const FString                 m_trace_id;
-		const FOnCacheUploadFinished  m_completion_delegate;
+		const FS3DownloadSource               m_source;
+		const FString                         m_trace_id;
+		const FOnCachedDownloadFinished       m_completion_delegate;
+		const FS3DownloadSettings             m_settings;
+		const S3ClientPtr                     m_client;
+		const S3RetryBudgetPtr                m_budget;
+		const S3ObjectCachePtr                m_cache;
 };
 
 } // anon ns
 
+FCriticalSection US3Impl::s_mutex;
+
+void US3Impl::BeginDestroy()
+{
+	shutdown();
+	Super::BeginDestroy();
+}
+
+void US3Impl::shutdown() noexcept
+{
+	// Blocks until all queued uploads went out
+	TUniquePtr<FS3UploadScheduler> scheduler;
+	{
+		FScopeLock slock(&s_mutex);
+		scheduler = MoveTemp(m_scheduler);
+		m_client.Reset();
+		m_object_cache.Reset();
+	}
+
+	scheduler.Reset();
+}
+
+void US3Impl::start_client(const FS3ClientSettings &n_settings)
+{
+	S3ClientPtr new_client;
+	{
+		FScopeLock slock(&s_mutex);
+		m_client_settings = n_settings;
+		m_client = create_client(m_client_settings);
+		new_client = m_client;
+	}
+
+	prewarm_client(new_client, m_default_bucket_name, n_settings.m_prewarm_connections);
+
+	// Clean up after earlier runs that never came back to their uploads
+	if (!m_upload_settings.m_journal_directory.IsEmpty())
+	{
+		Async(EAsyncExecution::ThreadPool, [new_client, directory{ m_upload_settings.m_journal_directory }, ttl{ m_upload_settings.m_journal_ttl }] {
+			FS3UploadJournal::abort_expired(*new_client, directory, ttl);
+		});
+	}
+}
+
+S3ClientPtr US3Impl::client()
+{
+	FScopeLock slock(&s_mutex);
+	if (!m_client)
+	{
+		m_client = create_client(m_client_settings);
+	}
+
+	return m_client;
+}
+
 void US3Impl::set_default_bucket_name(const FString &n_bucket_name) 
 {
 	m_default_bucket_name = n_bucket_name;
 }
 
-bool US3Impl::cache_upload(const FS3UploadTarget &n_target, TUniquePtr<unsigned char[]> &&n_data,
-		const size_t n_size, const FString &n_trace_id, const FOnCacheUploadFinished n_completion) 
+void US3Impl::set_upload_settings(const FS3UploadSettings &n_settings)
+{
+	FScopeLock slock(&s_mutex);
+	m_upload_settings = n_settings;
+	m_retry_budget = MakeShared<FS3RetryBudget, ESPMode::ThreadSafe>(m_upload_settings.m_retry_budget_ratio);
+}
+
+void US3Impl::set_download_settings(const FS3DownloadSettings &n_settings)
 {
-	FS3UploadTarget target = n_target;
-	if (target.BucketName.IsEmpty()) 
+	FScopeLock slock(&s_mutex);
+	m_download_settings = n_settings;
+}
+
+void US3Impl::set_cache_settings(const FS3CacheSettings &n_settings)
+{
+	FScopeLock slock(&s_mutex);
+	m_cache_settings = n_settings;
+}
+
+S3ObjectCachePtr US3Impl::object_cache()
+{
+	FScopeLock slock(&s_mutex);
+	if (!m_object_cache)
 	{
-		target.BucketName = m_default_bucket_name;
+		FS3CacheSettings settings = m_cache_settings;
+		if (settings.m_directory.IsEmpty())
+		{
+			settings.m_directory = FPaths::ConvertRelativePathToFull(
+					FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("MVAWS"), TEXT("ObjectCache")));
+		}
+		m_object_cache = MakeShared<FS3ObjectCache, ESPMode::ThreadSafe>(settings);
 	}
 
-	if (target.BucketName.IsEmpty()) 
+	return m_object_cache;
+}
+
+S3RetryBudgetPtr US3Impl::retry_budget()
+{
+	FScopeLock slock(&s_mutex);
+	if (!m_retry_budget)
+	{
+		m_retry_budget = MakeShared<FS3RetryBudget, ESPMode::ThreadSafe>(m_upload_settings.m_retry_budget_ratio);
+	}
+
+	return m_retry_budget;
+}
+
+FS3UploadScheduler &US3Impl::scheduler()
+{
+	FScopeLock slock(&s_mutex);
+	if (!m_scheduler)
+	{
+		m_scheduler = MakeUnique<FS3UploadScheduler>(m_upload_settings.m_max_concurrent_uploads, m_upload_settings.m_buffer_budget);
+	}
+
+	return *m_scheduler;
+}
+
+bool US3Impl::complete_target(const FS3UploadTarget &n_target, FS3UploadTarget &n_completed) const
+{
+	n_completed = n_target;
+	if (n_completed.BucketName.IsEmpty()) 
+	{
+		n_completed.BucketName = m_default_bucket_name;
+	}
+
+	if (n_completed.BucketName.IsEmpty()) 
 	{
 		UE_LOG(LogMVAWS, Error, TEXT("Need a bucket name to upload to cache. Plz configure AWSConnectionConfig actor"));
 		return false;
 	}
 	
-	if (n_target.ObjectKey.IsEmpty()) 
+	if (n_completed.ObjectKey.IsEmpty()) 
 	{
 		UE_LOG(LogMVAWS, Error, TEXT("Need an object name to upload to cache."));
 		return false;
 	}
 
+	return true;
+}
+
+bool US3Impl::cache_upload(const FS3UploadTarget &n_target, TUniquePtr<unsigned char[]> &&n_data,
+		const size_t n_size, const FString &n_trace_id, const FOnCacheUploadFinished n_completion) 
+{
+	return queue_membuf_upload(n_target, MoveTemp(n_data), n_size, FTimespan::Zero(), n_trace_id, n_completion);
+}
+
+bool US3Impl::cache_upload_blocking(const FS3UploadTarget &n_target, TUniquePtr<unsigned char[]> &&n_data,
+		const size_t n_size, const FTimespan &n_max_wait, const FString &n_trace_id, const FOnCacheUploadFinished n_completion) 
+{
+	return queue_membuf_upload(n_target, MoveTemp(n_data), n_size, n_max_wait, n_trace_id, n_completion);
+}
+
+bool US3Impl::queue_membuf_upload(const FS3UploadTarget &n_target, TUniquePtr<unsigned char[]> &&n_data,
+		const size_t n_size, const FTimespan &n_max_wait, const FString &n_trace_id, const FOnCacheUploadFinished n_completion) 
+{
+	FS3UploadTarget target;
+	if (!complete_target(n_target, target))
+	{
+		return false;
+	}
+
 	if (!n_data || !n_size) 
 	{
 		UE_LOG(LogMVAWS, Warning, TEXT("No data, no upload to S3 cache."));
 		return false;
 	}
 
-	UE_LOG(LogMVAWS, Display, TEXT("Upload of %u bytes to cache bucket '%s' initiating."), n_size, *m_default_bucket_name);
+	// Backpressure. If too much is buffered already, the caller keeps the buffer
+	// and may try again later. Nothing has been moved out of n_data at this point
+	FS3UploadScheduler &sched = scheduler();
+	const bool reserved = n_max_wait.IsZero() ? sched.try_reserve(n_size) : sched.reserve(n_size, n_max_wait);
+	if (!reserved)
+	{
+		UE_LOG(LogMVAWS, Warning, TEXT("Upload buffer budget exhausted (%llu bytes buffered), not uploading object '%s'"),
+				sched.buffered_bytes(), *target.ObjectKey);
+		return false;
+	}
+
+	UE_LOG(LogMVAWS, Display, TEXT("Upload of %u bytes to cache bucket '%s' initiating."), n_size, *target.BucketName);
 
 	// This looks like a memleak but really isn't as the task is self-owned and will delete itself when done.
 	// AWS clients also come with a built in thread executor which could handle this use case.
 	// However, I am using Unreal's Async task mechanism here to better integrate with the engine
 	// and to be able to post on the game thread without any unforseen complications.
-	(new FAutoDeleteAsyncTask<MembufUploadAsyncTask>(target, MoveTemp(n_data), n_size, n_trace_id, n_completion))->StartBackgroundTask();
+	// The scheduler's own pool limits how many run at once and keeps GThreadPool free.
+	(new FAutoDeleteAsyncTask<MembufUploadAsyncTask>(target, MoveTemp(n_data), n_size, n_trace_id, n_completion,
+			m_upload_settings, client(), retry_budget(), &sched))->StartBackgroundTask(sched.pool());
 
 	return true;
 }
@@ -330,42 +967,105 @@ bool US3Impl::cache_upload(const FS3UploadTarget &n_target, TUniquePtr<unsigned
 bool US3Impl::cache_upload(const FS3UploadTarget &n_target, const FString &n_file_path, 
 		const FString &n_trace_id, const FOnCacheUploadFinished n_completion)
 {
-	FS3UploadTarget target = n_target;
-	if (target.BucketName.IsEmpty())
+	FS3UploadTarget target;
+	if (!complete_target(n_target, target))
 	{
-		target.BucketName = m_default_bucket_name;
+		return false;
 	}
 
-	if (target.BucketName.IsEmpty())
+	if (n_file_path.IsEmpty())
 	{
-		UE_LOG(LogMVAWS, Error, TEXT("Need a bucket name to upload to cache. Plz configure AWSConnectionConfig actor"));
+		UE_LOG(LogMVAWS, Warning, TEXT("file path is empty, no upload to S3 cache."));
 		return false;
 	}
 
-	if (n_target.ObjectKey.IsEmpty())
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	if(!PlatformFile.FileExists(*n_file_path))
 	{
-		UE_LOG(LogMVAWS, Error, TEXT("Need an object name to upload to cache."));
+		UE_LOG(LogMVAWS, Warning, TEXT("file does not exist, no upload to S3 cache."));
 		return false;
 	}
 
+	UE_LOG(LogMVAWS, Display, TEXT("Upload of %s to cache bucket '%s' initiating."), *n_file_path, *target.BucketName);
+
+	// Files are not held in memory by us so they don't count against the budget
+	// but share the same concurrency limit
+	(new FAutoDeleteAsyncTask<FileUploadAsyncTask>(target, n_file_path, n_trace_id, n_completion, 
+			m_upload_settings, client(), retry_budget()))->StartBackgroundTask(scheduler().pool());
+
+	return true;
+}
+
+bool US3Impl::complete_source(const FS3DownloadSource &n_source, FS3DownloadSource &n_completed) const
+{
+	n_completed = n_source;
+	if (n_completed.BucketName.IsEmpty()) 
+	{
+		n_completed.BucketName = m_default_bucket_name;
+	}
+
+	if (n_completed.BucketName.IsEmpty()) 
+	{
+		UE_LOG(LogMVAWS, Error, TEXT("Need a bucket name to download from cache. Plz configure AWSConnectionConfig actor"));
+		return false;
+	}
 	
+	if (n_completed.ObjectKey.IsEmpty()) 
+	{
+		UE_LOG(LogMVAWS, Error, TEXT("Need an object name to download from cache."));
+		return false;
+	}
 
-	if (n_file_path.IsEmpty())
+	return true;
+}
+
+bool US3Impl::cache_download(const FS3DownloadSource &n_source, const FOnCacheDownloadFinished n_completion,
+		const FString &n_trace_id)
+{
+	FS3DownloadSource source;
+	if (!complete_source(n_source, source))
 	{
-		UE_LOG(LogMVAWS, Warning, TEXT("file path is empty, no upload to S3 cache."));
 		return false;
 	}
 
-	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
-	if(!PlatformFile.FileExists(*n_file_path))
+	(new FAutoDeleteAsyncTask<DownloadAsyncTask>(source, n_trace_id, n_completion,
+			m_download_settings, client(), retry_budget()))->StartBackgroundTask(scheduler().pool());
+
+	return true;
+}
+
+bool US3Impl::cache_download(const FS3DownloadSource &n_source, const FString &n_file_path,
+		const FString &n_trace_id, const FOnCacheDownloadToFileFinished n_completion)
+{
+	FS3DownloadSource source;
+	if (!complete_source(n_source, source))
 	{
-		UE_LOG(LogMVAWS, Warning, TEXT("file does not exist, no upload to S3 cache."));
 		return false;
 	}
 
-	UE_LOG(LogMVAWS, Display, TEXT("Upload of %s to cache bucket '%s' initiating."), *n_file_path, *target.BucketName);
+	if (n_file_path.IsEmpty())
+	{
+		UE_LOG(LogMVAWS, Error, TEXT("Need a file path to download '%s' to."), *source.ObjectKey);
+		return false;
+	}
+
+	(new FAutoDeleteAsyncTask<DownloadAsyncTask>(source, n_file_path, n_trace_id, n_completion,
+			m_download_settings, client(), retry_budget()))->StartBackgroundTask(scheduler().pool());
+
+	return true;
+}
+
+bool US3Impl::cached_download(const FS3DownloadSource &n_source, const FOnCachedDownloadFinished n_completion,
+		const FString &n_trace_id)
+{
+	FS3DownloadSource source;
+	if (!complete_source(n_source, source))
+	{
+		return false;
+	}
 
-	(new FAutoDeleteAsyncTask<FileUploadAsyncTask>(target, n_file_path, n_trace_id, n_completion))->StartBackgroundTask();
+	(new FAutoDeleteAsyncTask<CachedDownloadAsyncTask>(source, n_trace_id, n_completion,
+			m_download_settings, client(), retry_budget(), object_cache()))->StartBackgroundTask(scheduler().pool());
 
 	return true;
 }
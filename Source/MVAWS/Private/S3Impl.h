@@ -7,6 +7,9 @@
 #include "CoreMinimal.h"
 #include "MVAWS.h"
 #include "Templates/UniquePtr.h"
+#include "Misc/Timespan.h"
+#include "S3UploadScheduler.h"
+#include "S3Retry.h"
 
 #include "Windows/PreWindowsApi.h"
 #include <aws/core/Aws.h>
@@ -14,6 +17,119 @@
 
 #include "S3Impl.generated.h"
 
+/*!
+ * Tunables for how uploads are sent to S3.
+ * Set once from the config actor, copied into each upload task.
+ */
+struct FS3UploadSettings 
+{
+	/// payloads larger than this go out as multipart upload
+	uint64   m_multipart_threshold = 16ull * 1024 * 1024;
+
+	/// size of each part except the last one. S3 minimum is 5 MB
+	uint64   m_part_size = 8ull * 1024 * 1024;
+
+	/// number of parts of one upload being sent concurrently
+	uint32   m_parts_in_flight = 4;
+
+	/// how often a single part is re-sent before the upload is given up
+	uint32   m_part_retries = 3;
+
+	/// how often a failed upload is tried again, if the error allows
+	uint32   m_upload_retries = 3;
+
+	/// backoff before retry n is a random delay of up to min(max, base * 2^n) seconds
+	float    m_retry_base_delay = 0.2f;
+	float    m_retry_max_delay = 10.0f;
+
+	/// retries allowed per first attempt for all uploads of the process together
+	float    m_retry_budget_ratio = 0.1f;
+
+	/// uploads running at the same time, more are queued
+	uint32   m_max_concurrent_uploads = 8;
+
+	/// bytes of memory buffers queued and running uploads may hold together
+	uint64   m_buffer_budget = 1024ull * 1024 * 1024;
+
+	/// multipart uploads of files are recorded here so they can be resumed. Empty to turn that off
+	FString  m_journal_directory;
+
+	/// recorded uploads older than this are aborted instead of resumed
+	FTimespan m_journal_ttl = FTimespan::FromHours(24);
+};
+
+/*!
+ * Tunables for how objects are fetched from S3.
+ */
+struct FS3DownloadSettings 
+{
+	/// objects are fetched in ranges of this size, so larger ones come over several connections
+	uint64   m_part_size = 8ull * 1024 * 1024;
+
+	/// ranges of one download being fetched concurrently
+	uint32   m_parts_in_flight = 8;
+
+	/// how often a single range is fetched again before the download is given up
+	uint32   m_part_retries = 3;
+
+	/// how often a failed download is tried again, if the error allows
+	uint32   m_retries = 3;
+
+	/// backoff, see FS3UploadSettings
+	float    m_retry_base_delay = 0.2f;
+	float    m_retry_max_delay = 10.0f;
+};
+
+/*!
+ * Where and how much of S3 is kept locally for cached_download().
+ */
+struct FS3CacheSettings 
+{
+	FString  m_directory;
+
+	/// least recently used objects are evicted beyond this
+	uint64   m_max_bytes = 10ull * 1024 * 1024 * 1024;
+
+	/// objects validated less than this ago are served without asking S3. Zero asks every time
+	FTimespan m_revalidate_after = FTimespan::Zero();
+};
+
+/*!
+ * Connection tuning for the one S3 client all uploads share.
+ */
+struct FS3ClientSettings 
+{
+	/// size of the connection pool, also the number of executor threads for parts
+	uint32   m_max_connections = 25;
+
+	uint32   m_connect_timeout_ms = 1000;
+
+	/// how long a connection may stall while sending or receiving
+	uint32   m_request_timeout_ms = 10000;
+
+	bool     m_tcp_keep_alive = true;
+	uint32   m_tcp_keep_alive_interval_ms = 30000;
+
+	/// connections opened right away so the first uploads don't pay for TLS handshakes
+	uint32   m_prewarm_connections = 4;
+};
+
+namespace Aws::S3 {
+	class S3Client;
+}
+
+/// Uploads hold on to the client they started with
+using S3ClientPtr = TSharedPtr<Aws::S3::S3Client, ESPMode::ThreadSafe>;
+
+/// and the retry budget
+using S3RetryBudgetPtr = TSharedPtr<FS3RetryBudget, ESPMode::ThreadSafe>;
+
+class FS3ObjectCache;
+
+/// and the object cache, which lives as long as objects mapped from it
+using S3ObjectCachePtr = TSharedPtr<FS3ObjectCache, ESPMode::ThreadSafe>;
+
+
 /*!
  * Implementation wrapper for s3 functions.
  * This has no other function than bundle S3 related stuff in one place.
@@ -25,15 +141,83 @@ class US3Impl : public UObject
 	GENERATED_BODY()
 
 	public:
+		void BeginDestroy() override;
+
 		/// This is static here as I assume all uploads to go in one bucket.
 		/// If this is not desired, use FS3UploadTarget's setting below and ignore this
 		void set_default_bucket_name(const FString &n_bucket_name);
 
+		/// (Re-)create the shared client and open a few connections in the background.
+		/// Uploads still running keep using the client they started with.
+		void start_client(const FS3ClientSettings &n_settings);
+
+		/// Finish queued uploads and release the client. Call before SDK shutdown
+		void shutdown() noexcept;
+
+		/// Multipart thresholds, concurrency and retries, see FS3UploadSettings.
+		/// Concurrency and buffer budget only take effect before the first upload
+		void set_upload_settings(const FS3UploadSettings &n_settings);
+
+		/// Returns false and leaves n_data alone if the buffer budget is exhausted
 		bool cache_upload(const FS3UploadTarget &n_target, TUniquePtr<unsigned char []> &&n_data,
 				const size_t n_size, const FString &n_trace_id, const FOnCacheUploadFinished n_completion);
+
+		/// Same as above but waits up to n_max_wait for budget to become available
+		bool cache_upload_blocking(const FS3UploadTarget &n_target, TUniquePtr<unsigned char []> &&n_data,
+				const size_t n_size, const FTimespan &n_max_wait, const FString &n_trace_id, 
+				const FOnCacheUploadFinished n_completion);
 		
 		bool cache_upload(const FS3UploadTarget &n_target, const FString &n_file_path, 
 				const FString &n_trace_id, const FOnCacheUploadFinished n_completion);
+
+		/// Range sizes, concurrency and retries of downloads, see FS3DownloadSettings
+		void set_download_settings(const FS3DownloadSettings &n_settings);
+
+		bool cache_download(const FS3DownloadSource &n_source, const FOnCacheDownloadFinished n_completion,
+				const FString &n_trace_id);
+
+		bool cache_download(const FS3DownloadSource &n_source, const FString &n_file_path,
+				const FString &n_trace_id, const FOnCacheDownloadToFileFinished n_completion);
+
+		/// Directory, size cap and revalidation of the object cache.
+		/// Only takes effect before the first cached_download()
+		void set_cache_settings(const FS3CacheSettings &n_settings);
+
+		bool cached_download(const FS3DownloadSource &n_source, const FOnCachedDownloadFinished n_completion,
+				const FString &n_trace_id);
 	private:
-		FString   m_default_bucket_name;
+		/// check target and data, then queue when budget permits
+		bool queue_membuf_upload(const FS3UploadTarget &n_target, TUniquePtr<unsigned char []> &&n_data,
+				const size_t n_size, const FTimespan &n_max_wait, const FString &n_trace_id, 
+				const FOnCacheUploadFinished n_completion);
+
+		/// fill in the default bucket and check if we have enough to go on
+		bool complete_target(const FS3UploadTarget &n_target, FS3UploadTarget &n_completed) const;
+
+		/// same for downloads
+		bool complete_source(const FS3DownloadSource &n_source, FS3DownloadSource &n_completed) const;
+
+		/// created on first use
+		FS3UploadScheduler &scheduler();
+
+		/// created on first use with default settings unless start_client() was called
+		S3ClientPtr client();
+
+		/// shared by all uploads, created on first use
+		S3RetryBudgetPtr retry_budget();
+
+		/// created on first use. Its index is read by the first task using it, not here
+		S3ObjectCachePtr object_cache();
+
+		FString            m_default_bucket_name;
+		FS3UploadSettings  m_upload_settings;
+		FS3DownloadSettings m_download_settings;
+		FS3CacheSettings   m_cache_settings;
+		FS3ClientSettings  m_client_settings;
+
+		TUniquePtr<FS3UploadScheduler>  m_scheduler;
+		S3ClientPtr                     m_client;
+		S3RetryBudgetPtr                m_retry_budget;
+		S3ObjectCachePtr                m_object_cache;
+		static FCriticalSection         s_mutex;    //!< guards creation of scheduler, client, retry budget and cache
 };
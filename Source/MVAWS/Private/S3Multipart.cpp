@@ -0,0 +1,363 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#include "S3Multipart.h"
+#include "S3UploadJournal.h"
+
+// AWS SDK
+#include "Windows/PreWindowsApi.h"
+#include <aws/core/utils/memory/AWSMemory.h>
+#include <aws/core/utils/memory/stl/AWSVector.h>
+
+#include <aws/s3/S3Client.h>
+#include <aws/s3/S3Errors.h>
+#include <aws/s3/model/CreateMultipartUploadRequest.h>
+#include <aws/s3/model/UploadPartRequest.h>
+#include <aws/s3/model/CompleteMultipartUploadRequest.h>
+#include <aws/s3/model/AbortMultipartUploadRequest.h>
+#include <aws/s3/model/ListPartsRequest.h>
+#include <aws/s3/model/CompletedMultipartUpload.h>
+#include <aws/s3/model/CompletedPart.h>
+#include "Windows/PostWindowsApi.h"
+
+// Std
+#include <iostream>
+#include <future>
+
+using namespace Aws::S3::Model;
+
+namespace
+{
+
+/// S3 won't accept more than that many parts in one upload
+constexpr uint64 s_max_parts = 10000;
+
+/// and no part but the last may be smaller than this
+constexpr uint64 s_min_part_size = 5ull * 1024 * 1024;
+
+/// One part currently being sent
+struct part_in_flight
+{
+	int                        m_part_number;
+	uint32                     m_attempt;
+	UploadPartOutcomeCallable  m_outcome;
+};
+
+void abort_upload(Aws::S3::S3Client &n_client, const Aws::String &n_bucket, const Aws::String &n_key,
+		const Aws::String &n_upload_id, const FString &n_object_key)
+{
+	AbortMultipartUploadRequest abort_req;
+	abort_req.SetBucket(n_bucket);
+	abort_req.SetKey(n_key);
+	abort_req.SetUploadId(n_upload_id);
+	const AbortMultipartUploadOutcome abort_outcome = n_client.AbortMultipartUpload(abort_req);
+	if (!abort_outcome.IsSuccess() && abort_outcome.GetError().GetErrorType() != Aws::S3::S3Errors::NO_SUCH_UPLOAD)
+	{
+		UE_LOG(LogMVAWS, Warning, TEXT("Failed to abort multipart upload of object '%s': %s"), *n_object_key,
+				UTF8_TO_TCHAR(abort_outcome.GetError().GetMessage().c_str()));
+	}
+}
+
+/*!
+ * Find the parts of the journal's upload that S3 has, complete and in the size we would send.
+ * S3 knows better than the journal, which may miss the last parts before a crash.
+ * If S3 can't be asked, the journal's parts are taken and CompleteMultipartUpload will tell.
+ * \return false if the upload doesn't exist anymore
+ */
+bool reconcile_parts(Aws::S3::S3Client &n_client, const Aws::String &n_bucket, const Aws::String &n_key,
+		const FS3UploadJournal &n_journal, const uint64 n_total_size, TMap<int32, Aws::String> &n_parts)
+{
+	const uint64 part_size = n_journal.part_size();
+	const int num_parts = static_cast<int>((n_total_size + part_size - 1) / part_size);
+
+	ListPartsRequest list_req;
+	list_req.SetBucket(n_bucket);
+	list_req.SetKey(n_key);
+	list_req.SetUploadId(n_journal.upload_id());
+
+	for (;;)
+	{
+		const ListPartsOutcome list_outcome = n_client.ListParts(list_req);
+		if (!list_outcome.IsSuccess())
+		{
+			if (list_outcome.GetError().GetErrorType() == Aws::S3::S3Errors::NO_SUCH_UPLOAD)
+			{
+				return false;
+			}
+
+			UE_LOG(LogMVAWS, Warning, TEXT("Cannot list parts, trusting the upload journal: %s"),
+					UTF8_TO_TCHAR(list_outcome.GetError().GetMessage().c_str()));
+			n_parts = n_journal.parts();
+			return true;
+		}
+
+		const ListPartsResult &result = list_outcome.GetResult();
+		for (const Part &part : result.GetParts())
+		{
+			const int number = part.GetPartNumber();
+			if (number < 1 || number > num_parts)
+			{
+				continue;
+			}
+
+			const uint64 offset = static_cast<uint64>(number - 1) * part_size;
+			if (static_cast<uint64>(part.GetSize()) == FMath::Min(part_size, n_total_size - offset))
+			{
+				n_parts.Add(number, part.GetETag());
+			}
+		}
+
+		if (!result.GetIsTruncated())
+		{
+			return true;
+		}
+
+		list_req.SetPartNumberMarker(result.GetNextPartNumberMarker());
+	}
+}
+
+} // anon ns
+
+bool multipart_upload(Aws::S3::S3Client &n_client, const FS3UploadTarget &n_target,
+		const uint64 n_total_size, const FS3UploadSettings &n_settings,
+		const PartBodyFactory &n_body, FS3RetryBudget &n_budget, FS3Error &n_error, FS3UploadJournal *n_journal)
+{
+	const Aws::String bucket{ TCHAR_TO_UTF8(*n_target.BucketName) };
+	const Aws::String key{ TCHAR_TO_UTF8(*n_target.ObjectKey) };
+
+	// Grow the part size if the payload would be cut into too many pieces
+	uint64 part_size = FMath::Max(n_settings.m_part_size, s_min_part_size);
+	part_size = FMath::Max(part_size, (n_total_size + s_max_parts - 1) / s_max_parts);
+	const uint32 max_in_flight = FMath::Max(n_settings.m_parts_in_flight, 1u);
+
+	Aws::String upload_id;
+	TMap<int32, Aws::String> done_parts;
+
+	// Continue what an earlier attempt left behind
+	if (n_journal && !n_journal->upload_id().empty())
+	{
+		const uint64 resumed_part_size = n_journal->part_size();
+		if (n_journal->is_expired() || resumed_part_size < s_min_part_size
+				|| (n_total_size + resumed_part_size - 1) / resumed_part_size > s_max_parts)
+		{
+			abort_upload(n_client, bucket, key, n_journal->upload_id(), n_target.ObjectKey);
+			n_journal->remove();
+		}
+		else if (reconcile_parts(n_client, bucket, key, *n_journal, n_total_size, done_parts))
+		{
+			upload_id = n_journal->upload_id();
+			part_size = resumed_part_size;
+		}
+		else
+		{
+			n_journal->remove();
+		}
+	}
+
+	const int num_parts = static_cast<int>((n_total_size + part_size - 1) / part_size);
+
+	if (upload_id.empty())
+	{
+		CreateMultipartUploadRequest create_req;
+		create_req.SetBucket(bucket);
+		create_req.SetKey(key);
+		create_req.SetContentType(TCHAR_TO_UTF8(*n_target.ContentType));
+
+		const CreateMultipartUploadOutcome create_outcome = n_client.CreateMultipartUpload(create_req);
+		if (!create_outcome.IsSuccess())
+		{
+			n_error.set(create_outcome.GetError());
+			return false;
+		}
+
+		upload_id = create_outcome.GetResult().GetUploadId();
+
+		// Without a record of it, the upload can't be continued and is aborted on failure like before
+		if (n_journal && !n_journal->begin(upload_id, part_size))
+		{
+			n_journal = nullptr;
+		}
+
+		UE_LOG(LogMVAWS, Display, TEXT("Multipart upload of object '%s' started, %i parts of %llu bytes"),
+				*n_target.ObjectKey, num_parts, part_size);
+	}
+	else
+	{
+		UE_LOG(LogMVAWS, Display, TEXT("Multipart upload of object '%s' resumed, %i of %i parts of %llu bytes already uploaded"),
+				*n_target.ObjectKey, done_parts.Num(), num_parts, part_size);
+	}
+
+	// Fires a single part off into the client's executor. Body is created
+	// anew for every attempt so a retry always starts reading at the beginning
+	const auto send_part = [&](const int n_part_number, const uint32 n_attempt, part_in_flight &n_part) -> bool {
+
+		const uint64 offset = static_cast<uint64>(n_part_number - 1) * part_size;
+		const uint64 size = FMath::Min(part_size, n_total_size - offset);
+
+		const std::shared_ptr<Aws::IOStream> body = n_body(offset, size);
+		if (!body)
+		{
+			return false;
+		}
+
+		UploadPartRequest part_req;
+		part_req.SetBucket(bucket);
+		part_req.SetKey(key);
+		part_req.SetUploadId(upload_id);
+		part_req.SetPartNumber(n_part_number);
+		part_req.SetContentLength(static_cast<long long>(size));
+		part_req.SetBody(body);
+
+		if (n_attempt == 0)
+		{
+			n_budget.record_attempt();
+		}
+
+		n_part.m_part_number = n_part_number;
+		n_part.m_attempt = n_attempt;
+		n_part.m_outcome = n_client.UploadPartCallable(part_req);
+		return true;
+	};
+
+	Aws::Vector<CompletedPart> completed_parts(num_parts);
+	TArray<int> pending_parts;
+	for (int part_number = 1; part_number <= num_parts; part_number++)
+	{
+		if (const Aws::String *etag = done_parts.Find(part_number))
+		{
+			CompletedPart &cp = completed_parts[part_number - 1];
+			cp.SetPartNumber(part_number);
+			cp.SetETag(*etag);
+		}
+		else
+		{
+			pending_parts.Add(part_number);
+		}
+	}
+
+	TArray<part_in_flight> in_flight;
+	in_flight.Reserve(max_in_flight);
+
+	int32 next_part = 0;
+	bool failed = false;
+
+	while (!failed && (next_part < pending_parts.Num() || in_flight.Num()))
+	{
+		// keep the window full
+		while (next_part < pending_parts.Num() && static_cast<uint32>(in_flight.Num()) < max_in_flight)
+		{
+			part_in_flight p;
+			if (!send_part(pending_parts[next_part], 0, p))
+			{
+				n_error.set(FString::Printf(TEXT("Cannot read part %i"), pending_parts[next_part]));
+				failed = true;
+				break;
+			}
+
+			in_flight.Add(MoveTemp(p));
+			next_part++;
+		}
+
+		if (failed || !in_flight.Num())
+		{
+			break;
+		}
+
+		// Parts are roughly the same size so waiting for the oldest one
+		// is close enough to waiting for whichever finishes first
+		part_in_flight p = MoveTemp(in_flight[0]);
+		in_flight.RemoveAt(0, 1, false);
+
+		const UploadPartOutcome part_outcome = p.m_outcome.get();
+		if (part_outcome.IsSuccess())
+		{
+			CompletedPart &cp = completed_parts[p.m_part_number - 1];
+			cp.SetPartNumber(p.m_part_number);
+			cp.SetETag(part_outcome.GetResult().GetETag());
+			if (n_journal)
+			{
+				n_journal->part_done(p.m_part_number, cp.GetETag());
+			}
+			continue;
+		}
+
+		n_error.set(part_outcome.GetError());
+		if (should_retry(n_error, p.m_attempt, n_settings.m_part_retries, n_budget))
+		{
+			UE_LOG(LogMVAWS, Warning, TEXT("Part %i of object '%s' failed, retrying: %s"), p.m_part_number, *n_target.ObjectKey,
+					*n_error.m_message);
+
+			// Other parts keep going meanwhile
+			FPlatformProcess::Sleep(backoff_delay(p.m_attempt, n_settings.m_retry_base_delay, n_settings.m_retry_max_delay));
+
+			part_in_flight retry;
+			if (send_part(p.m_part_number, p.m_attempt + 1, retry))
+			{
+				in_flight.Add(MoveTemp(retry));
+				continue;
+			}
+		}
+
+		n_error.m_message = FString::Printf(TEXT("Part %i failed: %s"), p.m_part_number, *n_error.m_message);
+		failed = true;
+	}
+
+	if (failed)
+	{
+		// Parts still in flight reference our bodies and would be stored after
+		// the abort if we didn't wait for them
+		for (part_in_flight &p : in_flight)
+		{
+			const UploadPartOutcome part_outcome = p.m_outcome.get();
+			if (n_journal && part_outcome.IsSuccess())
+			{
+				n_journal->part_done(p.m_part_number, part_outcome.GetResult().GetETag());
+			}
+		}
+
+		if (n_journal)
+		{
+			UE_LOG(LogMVAWS, Display, TEXT("Multipart upload of object '%s' left open to be resumed"), *n_target.ObjectKey);
+		}
+		else
+		{
+			abort_upload(n_client, bucket, key, upload_id, n_target.ObjectKey);
+		}
+
+		return false;
+	}
+
+	CompletedMultipartUpload completed;
+	completed.SetParts(std::move(completed_parts));
+
+	CompleteMultipartUploadRequest complete_req;
+	complete_req.SetBucket(bucket);
+	complete_req.SetKey(key);
+	complete_req.SetUploadId(upload_id);
+	complete_req.SetMultipartUpload(std::move(completed));
+
+	const CompleteMultipartUploadOutcome complete_outcome = n_client.CompleteMultipartUpload(complete_req);
+	if (!complete_outcome.IsSuccess())
+	{
+		n_error.set(complete_outcome.GetError());
+
+		// Parts we thought were there aren't. Nothing to continue, start over next time
+		const Aws::Client::AWSError<Aws::S3::S3Errors> &error = complete_outcome.GetError();
+		if (n_journal && (error.GetErrorType() == Aws::S3::S3Errors::NO_SUCH_UPLOAD
+				|| error.GetExceptionName() == "InvalidPart" || error.GetExceptionName() == "InvalidPartOrder"))
+		{
+			abort_upload(n_client, bucket, key, upload_id, n_target.ObjectKey);
+			n_journal->remove();
+		}
+
+		return false;
+	}
+
+	if (n_journal)
+	{
+		n_journal->remove();
+	}
+
+	return true;
+}
@@ -0,0 +1,57 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#pragma once
+
+#include "CoreMinimal.h"
+#include "IMVAWS.h"
+#include "S3Impl.h"
+#include "S3Retry.h"
+
+#include "Windows/PreWindowsApi.h"
+#include <aws/core/Aws.h>
+#include <aws/core/utils/memory/stl/AWSStreamFwd.h>
+#include <aws/core/utils/memory/stl/AWSString.h>
+#include "Windows/PostWindowsApi.h"
+
+#include <memory>
+
+namespace Aws::S3 {
+	class S3Client;
+}
+
+class FS3UploadJournal;
+
+/*!
+ * Called once per part (and again for each retry of that part) to get
+ * a fresh body stream for the byte range [n_offset, n_offset + n_size) of the payload.
+ * Will be called on the thread running multipart_upload().
+ * Returning nullptr fails the upload.
+ */
+using PartBodyFactory = TFunction<std::shared_ptr<Aws::IOStream>(const uint64 n_offset, const uint64 n_size)>;
+
+/*!
+ * Upload a payload of n_total_size bytes using CreateMultipartUpload, UploadPart and
+ * CompleteMultipartUpload. Up to n_settings.m_parts_in_flight parts are sent concurrently
+ * using the client's executor, each part is retried on its own with backoff, as far as
+ * the error allows and the retry budget permits.
+ * If the upload cannot be completed it is aborted so no orphaned parts remain.
+ * With a journal, it is left open instead and a later call with the same journal
+ * continues it, sending only the parts S3 doesn't have yet.
+ * Blocks until done.
+ *
+ * \param n_client S3 client to use, must be thread safe
+ * \param n_target where to, bucket name must be set
+ * \param n_total_size size of the payload in bytes
+ * \param n_settings part size, concurrency and retries
+ * \param n_body produces the stream for each part
+ * \param n_budget retries of parts are taken from here
+ * \param n_error receives what went wrong when false is returned
+ * \param n_journal records the upload as it goes, optional
+ * \return true when the object was assembled successfully
+ */
+bool multipart_upload(Aws::S3::S3Client &n_client, const FS3UploadTarget &n_target,
+		const uint64 n_total_size, const FS3UploadSettings &n_settings,
+		const PartBodyFactory &n_body, FS3RetryBudget &n_budget, FS3Error &n_error,
+		FS3UploadJournal *n_journal = nullptr);
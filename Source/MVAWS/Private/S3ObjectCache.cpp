@@ -0,0 +1,474 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#include "S3ObjectCache.h"
+#include "Utils.h"
+
+#include "Async/MappedFileHandle.h"
+#include "GenericPlatform/GenericPlatformFile.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Guid.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+
+namespace {
+
+const TCHAR *s_object_extension = TEXT(".object");
+const TCHAR *s_index_name = TEXT("index.txt");
+const TCHAR *s_new_index_name = TEXT("index.txt.new");
+const TCHAR *s_part_extension = TEXT(".part");
+const TCHAR *s_download_extension = TEXT(".part.download");    //!< what ranged_download_to_file() makes of a .part
+
+/// "bucket/key", how m_current knows objects
+FString source_key(const FString &n_bucket, const FString &n_key)
+{
+	return n_bucket + TEXT("/") + n_key;
+}
+
+/// file name of one version of an object
+FString entry_name(const FString &n_bucket, const FString &n_key, const FString &n_etag)
+{
+	return md5_utf8(FString::Printf(TEXT("%s\n%s\n%s"), *n_bucket, *n_key, *n_etag)) + s_object_extension;
+}
+
+/// a file the cache made. Anything else in the directory isn't ours to delete
+bool is_cache_file(const FString &n_file)
+{
+	return n_file.EndsWith(s_object_extension) || n_file.EndsWith(s_part_extension)
+			|| n_file.EndsWith(s_download_extension) || n_file == s_new_index_name;
+}
+
+}
+
+/*!
+ * What the cache hands out. Unmaps and unpins when the last reference goes.
+ */
+class FS3MappedObject : public FS3CachedObject
+{
+	public:
+		FS3MappedObject(TSharedRef<FS3ObjectCache, ESPMode::ThreadSafe> &&n_cache, const FString &n_name,
+				const FString &n_path, TUniquePtr<IMappedFileHandle> &&n_file, TUniquePtr<IMappedFileRegion> &&n_region)
+				: m_cache{ MoveTemp(n_cache) }
+				, m_name{ n_name }
+				, m_path{ n_path }
+				, m_file{ MoveTemp(n_file) }
+				, m_region{ MoveTemp(n_region) } {}
+
+		~FS3MappedObject() noexcept
+		{
+			// The file must be unmapped before the cache may delete it
+			m_region.Reset();
+			m_file.Reset();
+			m_cache->release(m_name);
+		}
+
+		const uint8 *data() const noexcept override
+		{
+			return m_region ? m_region->GetMappedPtr() : nullptr;
+		}
+
+		int64 size() const noexcept override
+		{
+			return m_region ? m_region->GetMappedSize() : 0;
+		}
+
+		const FString &file_path() const noexcept override
+		{
+			return m_path;
+		}
+
+	private:
+		const TSharedRef<FS3ObjectCache, ESPMode::ThreadSafe>  m_cache;
+		const FString                    m_name;
+		const FString                    m_path;
+		TUniquePtr<IMappedFileHandle>    m_file;
+		TUniquePtr<IMappedFileRegion>    m_region;    //!< null for empty objects
+};
+
+FS3ObjectCache::FS3ObjectCache(const FS3CacheSettings &n_settings)
+		: m_settings{ n_settings }
+{
+}
+
+FS3ObjectCache::~FS3ObjectCache() noexcept
+{
+	// Nothing can be pinned anymore, mapped objects hold on to us
+	if (m_dirty)
+	{
+		save_index();
+	}
+}
+
+bool FS3ObjectCache::lookup(const FS3DownloadSource &n_source, Aws::String &n_etag, bool &n_fresh)
+{
+	FScopeLock lock(&m_mutex);
+	load();
+	tidy();
+
+	const FString *name = m_current.Find(source_key(n_source.BucketName, n_source.ObjectKey));
+	const FEntry *entry = name ? m_entries.Find(*name) : nullptr;
+	if (!entry)
+	{
+		return false;
+	}
+
+	n_etag = TCHAR_TO_UTF8(*entry->m_etag);
+	n_fresh = m_settings.m_revalidate_after > FTimespan::Zero()
+			&& FDateTime::UtcNow() - entry->m_validated < m_settings.m_revalidate_after;
+	return true;
+}
+
+FS3CachedObjectPtr FS3ObjectCache::open(const FS3DownloadSource &n_source, const Aws::String &n_etag, const bool n_validated)
+{
+	FScopeLock lock(&m_mutex);
+	load();
+	tidy();
+
+	const FString name = entry_name(n_source.BucketName, n_source.ObjectKey, UTF8_TO_TCHAR(n_etag.c_str()));
+	FEntry *entry = m_entries.Find(name);
+	if (!entry || entry->m_stale)
+	{
+		return nullptr;
+	}
+
+	if (n_validated)
+	{
+		entry->m_validated = FDateTime::UtcNow();
+	}
+
+	return map(name, *entry);
+}
+
+FString FS3ObjectCache::temp_path() const
+{
+	return FPaths::Combine(m_settings.m_directory, FGuid::NewGuid().ToString() + s_part_extension);
+}
+
+FS3CachedObjectPtr FS3ObjectCache::insert(const FS3DownloadSource &n_source, const Aws::String &n_etag, const FString &n_temp_path)
+{
+	IPlatformFile &platform_file = FPlatformFileManager::Get().GetPlatformFile();
+	const FString etag{ UTF8_TO_TCHAR(n_etag.c_str()) };
+	const FString name = entry_name(n_source.BucketName, n_source.ObjectKey, etag);
+	const FString path = file_path(name);
+
+	FScopeLock lock(&m_mutex);
+	load();
+	tidy();
+
+	FEntry *entry = m_entries.Find(name);
+	if (entry && !entry->m_stale)
+	{
+		// Somebody else downloaded the same version meanwhile
+		platform_file.DeleteFile(*n_temp_path);
+	}
+	else
+	{
+		if (entry)
+		{
+			// The same version came back while the old copy is still pinned. It's the same content
+			// but we can't replace a mapped file, so that one stays
+			entry->m_stale = false;
+			platform_file.DeleteFile(*n_temp_path);
+		}
+		else
+		{
+			if (!platform_file.MoveFile(*path, *n_temp_path))
+			{
+				UE_LOG(LogMVAWS, Warning, TEXT("Cannot move download of object '%s' into the cache at '%s'"), *n_source.ObjectKey, *path);
+				platform_file.DeleteFile(*n_temp_path);
+				return nullptr;
+			}
+
+			entry = &m_entries.Add(name);
+			entry->m_bucket = n_source.BucketName;
+			entry->m_key = n_source.ObjectKey;
+			entry->m_etag = etag;
+			entry->m_size = static_cast<uint64>(FMath::Max(platform_file.FileSize(*path), 0ll));
+			m_total_bytes += entry->m_size;
+		}
+	}
+
+	entry->m_validated = FDateTime::UtcNow();
+
+	// The version we had before is out of date
+	const FString key = source_key(n_source.BucketName, n_source.ObjectKey);
+	const FString *previous = m_current.Find(key);
+	if (previous && *previous != name)
+	{
+		const FString previous_name = *previous;
+		FEntry &previous_entry = m_entries[previous_name];
+		if (previous_entry.m_pins)
+		{
+			previous_entry.m_stale = true;
+		}
+		else
+		{
+			remove(previous_name);
+		}
+	}
+	m_current.Add(key, name);
+
+	// Pinned first, so it isn't evicted right away when it's bigger than the cap
+	FS3CachedObjectPtr object = map(name, m_entries[name]);
+	evict();
+	save_index();
+	return object;
+}
+
+void FS3ObjectCache::load()
+{
+	if (m_loaded)
+	{
+		return;
+	}
+
+	m_loaded = true;
+	FPlatformFileManager::Get().GetPlatformFile().CreateDirectoryTree(*m_settings.m_directory);
+	load_index();
+	evict();
+	save_index();
+}
+
+void FS3ObjectCache::release(const FString &n_name)
+{
+	FScopeLock lock(&m_mutex);
+
+	FEntry *entry = m_entries.Find(n_name);
+	if (!entry || --entry->m_pins > 0)
+	{
+		return;
+	}
+
+	// This may well be the game thread. Deleting and evicting is left to the next task
+	m_dirty = true;
+	if (entry->m_stale || m_total_bytes > m_settings.m_max_bytes)
+	{
+		m_untidy = true;
+	}
+}
+
+void FS3ObjectCache::tidy()
+{
+	if (!m_untidy)
+	{
+		return;
+	}
+
+	m_untidy = false;
+
+	// Replaced versions and anything we had to keep beyond the cap may go now
+	TArray<FString> stale;
+	for (const TPair<FString, FEntry> &entry : m_entries)
+	{
+		if (entry.Value.m_stale && !entry.Value.m_pins)
+		{
+			stale.Add(entry.Key);
+		}
+	}
+
+	for (const FString &name : stale)
+	{
+		remove(name);
+	}
+
+	evict();
+	save_index();
+}
+
+FS3CachedObjectPtr FS3ObjectCache::map(const FString &n_name, FEntry &n_entry)
+{
+	const FString path = file_path(n_name);
+
+	TUniquePtr<IMappedFileHandle> file;
+	TUniquePtr<IMappedFileRegion> region;
+	if (n_entry.m_size)
+	{
+		file.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*path));
+		if (file)
+		{
+			region.Reset(file->MapRegion(0, file->GetFileSize()));
+		}
+
+		if (!region || static_cast<uint64>(region->GetMappedSize()) != n_entry.m_size)
+		{
+			UE_LOG(LogMVAWS, Warning, TEXT("Cannot map cached object '%s' from '%s', dropping it"), *n_entry.m_key, *path);
+			region.Reset();
+			file.Reset();
+			if (!n_entry.m_pins)
+			{
+				remove(n_name);
+				save_index();
+			}
+			return nullptr;
+		}
+	}
+
+	n_entry.m_pins++;
+	n_entry.m_last_used = FDateTime::UtcNow();
+	m_dirty = true;
+
+	return MakeShared<FS3MappedObject, ESPMode::ThreadSafe>(AsShared(), n_name, path, MoveTemp(file), MoveTemp(region));
+}
+
+void FS3ObjectCache::remove(const FString &n_name)
+{
+	const FEntry *entry = m_entries.Find(n_name);
+	if (!entry)
+	{
+		return;
+	}
+
+	const FString key = source_key(entry->m_bucket, entry->m_key);
+	const FString *current = m_current.Find(key);
+	if (current && *current == n_name)
+	{
+		m_current.Remove(key);
+	}
+
+	FPlatformFileManager::Get().GetPlatformFile().DeleteFile(*file_path(n_name));
+	m_total_bytes -= FMath::Min(m_total_bytes, entry->m_size);
+	m_entries.Remove(n_name);
+	m_dirty = true;
+}
+
+void FS3ObjectCache::evict()
+{
+	if (m_total_bytes <= m_settings.m_max_bytes)
+	{
+		return;
+	}
+
+	TArray<TPair<FDateTime, FString>> candidates;
+	for (const TPair<FString, FEntry> &entry : m_entries)
+	{
+		if (!entry.Value.m_pins)
+		{
+			candidates.Emplace(entry.Value.m_last_used, entry.Key);
+		}
+	}
+	candidates.Sort([](const TPair<FDateTime, FString> &n_lhs, const TPair<FDateTime, FString> &n_rhs) {
+		return n_lhs.Key < n_rhs.Key;
+	});
+
+	int32 evicted = 0;
+	for (const TPair<FDateTime, FString> &candidate : candidates)
+	{
+		if (m_total_bytes <= m_settings.m_max_bytes)
+		{
+			break;
+		}
+
+		remove(candidate.Value);
+		evicted++;
+	}
+
+	if (evicted)
+	{
+		UE_LOG(LogMVAWS, Verbose, TEXT("Evicted %i objects from the S3 object cache, %llu bytes left"), evicted, m_total_bytes);
+	}
+}
+
+// One line per object, tab separated:
+// file name, size, last used and validated in ticks, ETag, bucket, key.
+// The key goes last, so a tab in it doesn't throw us off
+void FS3ObjectCache::load_index()
+{
+	IPlatformFile &platform_file = FPlatformFileManager::Get().GetPlatformFile();
+
+	// A crash between writing the new index and renaming it leaves only the new one
+	FString index_path = FPaths::Combine(m_settings.m_directory, s_index_name);
+	if (!platform_file.FileExists(*index_path))
+	{
+		index_path = FPaths::Combine(m_settings.m_directory, s_new_index_name);
+	}
+
+	TArray<FString> lines;
+	FFileHelper::LoadFileToStringArray(lines, *index_path);
+
+	for (const FString &line : lines)
+	{
+		TArray<FString> fields;
+		line.ParseIntoArray(fields, TEXT("\t"), false);
+		if (fields.Num() < 7)
+		{
+			continue;
+		}
+
+		FEntry entry;
+		entry.m_size = FCString::Strtoui64(*fields[1], nullptr, 10);
+		entry.m_last_used = FDateTime{ FCString::Atoi64(*fields[2]) };
+		entry.m_validated = FDateTime{ FCString::Atoi64(*fields[3]) };
+		entry.m_etag = fields[4];
+		entry.m_bucket = fields[5];
+		entry.m_key = fields[6];
+		for (int32 i = 7; i < fields.Num(); i++)
+		{
+			entry.m_key += TEXT("\t") + fields[i];
+		}
+
+		// Only what's still there as we left it
+		const FString &name = fields[0];
+		if (name != entry_name(entry.m_bucket, entry.m_key, entry.m_etag)
+				|| platform_file.FileSize(*file_path(name)) != static_cast<int64>(entry.m_size))
+		{
+			continue;
+		}
+
+		m_total_bytes += entry.m_size;
+		m_current.Add(source_key(entry.m_bucket, entry.m_key), name);
+		m_entries.Add(name, MoveTemp(entry));
+	}
+
+	// Partial downloads, replaced versions pinned when we went down and other leftovers
+	TArray<FString> files;
+	IFileManager::Get().FindFiles(files, *m_settings.m_directory, nullptr);
+	for (const FString &file : files)
+	{
+		if (is_cache_file(file) && !m_entries.Contains(file))
+		{
+			platform_file.DeleteFile(*file_path(file));
+		}
+	}
+
+	UE_LOG(LogMVAWS, Display, TEXT("S3 object cache in '%s' has %i objects, %llu bytes"), *m_settings.m_directory,
+			m_entries.Num(), m_total_bytes);
+}
+
+void FS3ObjectCache::save_index()
+{
+	FString index;
+	for (const TPair<FString, FEntry> &entry : m_entries)
+	{
+		// Replaced versions are gone as soon as they are let go, they aren't coming back
+		if (entry.Value.m_stale)
+		{
+			continue;
+		}
+
+		index += FString::Printf(TEXT("%s\t%llu\t%lld\t%lld\t%s\t%s\t%s\n"), *entry.Key, entry.Value.m_size,
+				entry.Value.m_last_used.GetTicks(), entry.Value.m_validated.GetTicks(), *entry.Value.m_etag,
+				*entry.Value.m_bucket, *entry.Value.m_key);
+	}
+
+	// Written aside and renamed, so there's always one complete index
+	IPlatformFile &platform_file = FPlatformFileManager::Get().GetPlatformFile();
+	const FString index_path = FPaths::Combine(m_settings.m_directory, s_index_name);
+	const FString new_index_path = FPaths::Combine(m_settings.m_directory, s_new_index_name);
+	if (!FFileHelper::SaveStringToFile(index, *new_index_path, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM)
+			|| (!platform_file.DeleteFile(*index_path) && platform_file.FileExists(*index_path))
+			|| !platform_file.MoveFile(*index_path, *new_index_path))
+	{
+		UE_LOG(LogMVAWS, Warning, TEXT("Cannot write S3 object cache index '%s'"), *index_path);
+		return;
+	}
+
+	m_dirty = false;
+}
+
+FString FS3ObjectCache::file_path(const FString &n_name) const
+{
+	return FPaths::Combine(m_settings.m_directory, n_name);
+}
@@ -0,0 +1,109 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#pragma once
+
+#include "CoreMinimal.h"
+#include "IMVAWS.h"
+#include "S3Impl.h"
+#include "HAL/CriticalSection.h"
+#include "Misc/DateTime.h"
+
+#include "Windows/PreWindowsApi.h"
+#include <aws/core/Aws.h>
+#include <aws/core/utils/memory/stl/AWSString.h>
+#include "Windows/PostWindowsApi.h"
+
+/*!
+ * Local copies of S3 objects in one directory, up to a size cap.
+ * Each version of an object is a file named after bucket, key and ETag. An index file lists
+ * them with their ETag and when they were last used and validated, so the cache survives restarts.
+ * Files not in the index are leftovers of a crash and deleted on startup.
+ * Objects in use are mapped and pinned: they aren't evicted and a replaced version is only
+ * deleted after it was released, by the next task using the cache. The least recently used unpinned objects go when the cap is exceeded.
+ * The index is written when objects come or go. Last use and validation times of hits are
+ * written along with the next change, or when the cache is destroyed.
+ * Thread safe. Only one process may use a directory at a time.
+ */
+class FS3ObjectCache : public TSharedFromThis<FS3ObjectCache, ESPMode::ThreadSafe>
+{
+	public:
+		/// Cheap. The index is read and the directory cleaned up by the first lookup(), open() or insert()
+		explicit FS3ObjectCache(const FS3CacheSettings &n_settings);
+		~FS3ObjectCache() noexcept;
+
+		/*!
+		 * Which version of the object we have, if any.
+		 * \param n_etag ETag of the cached version
+		 * \param n_fresh it was validated within m_revalidate_after, no need to ask S3
+		 */
+		bool lookup(const FS3DownloadSource &n_source, Aws::String &n_etag, bool &n_fresh);
+
+		/*!
+		 * Map and pin the cached version with this ETag.
+		 * \param n_validated S3 just confirmed it is current
+		 * \return null if it has been evicted meanwhile or can't be mapped
+		 */
+		FS3CachedObjectPtr open(const FS3DownloadSource &n_source, const Aws::String &n_etag, const bool n_validated);
+
+		/// where to download a new object to before insert()
+		FString temp_path() const;
+
+		/*!
+		 * Move a downloaded object into the cache, replacing older versions of it.
+		 * Then evict beyond the size cap and map it. n_temp_path is gone afterwards either way.
+		 * \return null if the file couldn't be moved or mapped
+		 */
+		FS3CachedObjectPtr insert(const FS3DownloadSource &n_source, const Aws::String &n_etag, const FString &n_temp_path);
+
+	private:
+		friend class FS3MappedObject;
+
+		struct FEntry
+		{
+			FString    m_bucket;
+			FString    m_key;
+			FString    m_etag;
+			uint64     m_size = 0;
+			FDateTime  m_last_used;
+			FDateTime  m_validated;
+			int32      m_pins = 0;        //!< mapped objects handed out
+			bool       m_stale = false;   //!< replaced by a newer version, deleted when unpinned
+		};
+
+		/// a mapped object was let go. Only unpins, no file IO
+		void release(const FString &n_name);
+
+		// All below with m_mutex held
+
+		/// read the index and clean up, once. Blocking file IO
+		void load();
+
+		/// delete what release() left behind and evict. Blocking file IO
+		void tidy();
+
+		/// map the entry's file, pin and touch it
+		FS3CachedObjectPtr map(const FString &n_name, FEntry &n_entry);
+
+		/// delete the entry and its file
+		void remove(const FString &n_name);
+
+		/// remove unpinned entries, least recently used first, until we're within the cap
+		void evict();
+
+		void load_index();
+		void save_index();
+
+		FString file_path(const FString &n_name) const;
+
+		const FS3CacheSettings   m_settings;
+
+		mutable FCriticalSection m_mutex;
+		TMap<FString, FEntry>    m_entries;    //!< by file name
+		TMap<FString, FString>   m_current;    //!< "bucket/key" to file name of the version we have
+		uint64                   m_total_bytes = 0;
+		bool                     m_loaded = false;
+		bool                     m_dirty = false;   //!< times changed since the index was written
+		bool                     m_untidy = false;  //!< released entries wait for tidy()
+};
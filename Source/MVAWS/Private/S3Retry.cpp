@@ -0,0 +1,125 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#include "S3Retry.h"
+#include "IMVAWS.h"
+
+#include "Misc/ScopeLock.h"
+
+namespace {
+
+/// at most this many retries are saved up
+constexpr float s_max_tokens = 20.0f;
+
+/// retries per second everybody gets regardless of traffic
+constexpr float s_refill_per_second = 0.5f;
+
+}
+
+void FS3Error::set(const Aws::Client::AWSError<Aws::S3::S3Errors> &n_error)
+{
+	m_message = UTF8_TO_TCHAR(n_error.GetMessage().c_str());
+	if (m_message.IsEmpty())
+	{
+		m_message = UTF8_TO_TCHAR(n_error.GetExceptionName().c_str());
+	}
+	m_retryable = is_retryable(n_error);
+}
+
+void FS3Error::set(const FString &n_message)
+{
+	m_message = n_message;
+	m_retryable = false;
+}
+
+bool is_retryable(const Aws::Client::AWSError<Aws::S3::S3Errors> &n_error) noexcept
+{
+	// The SDK knows throttling and transient errors
+	if (n_error.ShouldRetry())
+	{
+		return true;
+	}
+
+	switch (n_error.GetErrorType())
+	{
+		case Aws::S3::S3Errors::NETWORK_CONNECTION:
+		case Aws::S3::S3Errors::REQUEST_TIMEOUT:
+		case Aws::S3::S3Errors::SERVICE_UNAVAILABLE:
+		case Aws::S3::S3Errors::SLOW_DOWN:
+		case Aws::S3::S3Errors::THROTTLING:
+		case Aws::S3::S3Errors::INTERNAL_FAILURE:
+			return true;
+		default:
+			break;
+	}
+
+	// 5xx and 429, whatever S3 calls them
+	const int status = static_cast<int>(n_error.GetResponseCode());
+	if (status >= 500 || status == 429)
+	{
+		return true;
+	}
+
+	// S3's own names for throttling and timeouts that may come as "unknown" errors
+	const Aws::String &name = n_error.GetExceptionName();
+	return name == "SlowDown" || name == "RequestTimeout" || name == "RequestTimeTooSkewed";
+}
+
+float backoff_delay(const uint32 n_attempt, const float n_base, const float n_max) noexcept
+{
+	const float ceiling = FMath::Min(n_max, n_base * static_cast<float>(1ull << FMath::Min(n_attempt, 30u)));
+	return FMath::FRandRange(0.0f, ceiling);
+}
+
+bool should_retry(const FS3Error &n_error, const uint32 n_attempt, const uint32 n_max_retries, FS3RetryBudget &n_budget) noexcept
+{
+	if (!n_error.m_retryable || n_attempt >= n_max_retries)
+	{
+		return false;
+	}
+
+	if (!n_budget.try_retry())
+	{
+		UE_LOG(LogMVAWS, Warning, TEXT("S3 retry budget exhausted, not retrying: %s"), *n_error.m_message);
+		IMVAWSModule::Get().count_s3_retry(false);
+		return false;
+	}
+
+	IMVAWSModule::Get().count_s3_retry(true);
+	return true;
+}
+
+FS3RetryBudget::FS3RetryBudget(const float n_ratio)
+		: m_ratio{ FMath::Max(n_ratio, 0.0f) }
+		, m_tokens{ s_max_tokens }
+		, m_last_refill{ FPlatformTime::Seconds() }
+{
+}
+
+void FS3RetryBudget::refill() noexcept
+{
+	const double now = FPlatformTime::Seconds();
+	m_tokens = FMath::Min(s_max_tokens, m_tokens + static_cast<float>(now - m_last_refill) * s_refill_per_second);
+	m_last_refill = now;
+}
+
+void FS3RetryBudget::record_attempt() noexcept
+{
+	FScopeLock lock(&m_mutex);
+	refill();
+	m_tokens = FMath::Min(s_max_tokens, m_tokens + m_ratio);
+}
+
+bool FS3RetryBudget::try_retry() noexcept
+{
+	FScopeLock lock(&m_mutex);
+	refill();
+	if (m_tokens < 1.0f)
+	{
+		return false;
+	}
+
+	m_tokens -= 1.0f;
+	return true;
+}
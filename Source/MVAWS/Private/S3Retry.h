@@ -0,0 +1,82 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+
+#include "Windows/PreWindowsApi.h"
+#include <aws/core/Aws.h>
+#include <aws/core/client/AWSError.h>
+#include <aws/s3/S3Errors.h>
+#include "Windows/PostWindowsApi.h"
+
+/*!
+ * What went wrong with an S3 upload and whether trying again may help
+ */
+struct FS3Error
+{
+	FString  m_message;
+	bool     m_retryable = false;
+
+	/// take message and classification from an SDK error
+	void set(const Aws::Client::AWSError<Aws::S3::S3Errors> &n_error);
+
+	/// something on our side, like a file that can't be read. Not retryable
+	void set(const FString &n_message);
+};
+
+/*!
+ * Throttling, server errors, timeouts and broken connections are worth another try.
+ * Access denied, missing buckets and the like are not.
+ */
+bool is_retryable(const Aws::Client::AWSError<Aws::S3::S3Errors> &n_error) noexcept;
+
+/*!
+ * Capped exponential backoff with full jitter: a random delay between 0 and
+ * min(n_max, n_base * 2^n_attempt) in seconds.
+ * \param n_attempt 0 for the first retry
+ */
+float backoff_delay(const uint32 n_attempt, const float n_base, const float n_max) noexcept;
+
+class FS3RetryBudget;
+
+/*!
+ * Whether to try again after attempt n_attempt (0 for the first) failed with n_error.
+ * Takes the retry from n_budget and counts it in metrics, also when the budget says no.
+ */
+bool should_retry(const FS3Error &n_error, const uint32 n_attempt, const uint32 n_max_retries, FS3RetryBudget &n_budget) noexcept;
+
+/*!
+ * Limits retries of all uploads of this process together, so that when S3 throttles
+ * the retries don't add to the load that caused it.
+ * Every first attempt earns a fraction of a retry and every retry costs one.
+ * Additionally the budget refills by a small constant rate, so lone uploads may
+ * still retry when there's little traffic. Unused retries accumulate up to a cap.
+ * Thread safe.
+ */
+class FS3RetryBudget
+{
+	public:
+		/*!
+		 * \param n_ratio retries per first attempt, e.g. 0.1 for one retry per ten uploads
+		 */
+		explicit FS3RetryBudget(const float n_ratio);
+
+		/// a first attempt was made
+		void record_attempt() noexcept;
+
+		/// take one retry from the budget. Returns false if there's none left
+		bool try_retry() noexcept;
+
+	private:
+		void refill() noexcept;
+
+		const float       m_ratio;
+
+		FCriticalSection  m_mutex;
+		float             m_tokens;
+		double            m_last_refill;
+};
@@ -0,0 +1,283 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#include "S3Streams.h"
+
+#include "Misc/ScopeLock.h"
+
+#include <cstring>
+
+namespace {
+
+/// buffered per range before it goes to the file
+constexpr int32 s_file_range_buffer_bytes = 256 * 1024;
+
+}
+
+FReadOnlyMemoryStreamBuf::FReadOnlyMemoryStreamBuf(const unsigned char *n_data, const uint64 n_size)
+		// The get area wants non-const pointers. We never write through them
+		: m_begin{ reinterpret_cast<char *>(const_cast<unsigned char *>(n_data)) }
+		, m_size{ n_size }
+{
+	setg(m_begin, m_begin, m_begin + m_size);
+}
+
+FReadOnlyMemoryStreamBuf::pos_type FReadOnlyMemoryStreamBuf::seekoff(off_type n_off, std::ios_base::seekdir n_dir, std::ios_base::openmode n_which)
+{
+	if (n_which & std::ios_base::out)
+	{
+		return pos_type(off_type(-1));
+	}
+
+	off_type base = 0;
+	switch (n_dir)
+	{
+		case std::ios_base::beg:
+			base = 0;
+			break;
+		case std::ios_base::cur:
+			base = gptr() - eback();
+			break;
+		case std::ios_base::end:
+			base = static_cast<off_type>(m_size);
+			break;
+		default:
+			return pos_type(off_type(-1));
+	}
+
+	return seekpos(pos_type(base + n_off), n_which);
+}
+
+FReadOnlyMemoryStreamBuf::pos_type FReadOnlyMemoryStreamBuf::seekpos(pos_type n_pos, std::ios_base::openmode n_which)
+{
+	const off_type pos = static_cast<off_type>(n_pos);
+	if ((n_which & std::ios_base::out) || pos < 0 || static_cast<uint64>(pos) > m_size)
+	{
+		return pos_type(off_type(-1));
+	}
+
+	setg(m_begin, m_begin + pos, m_begin + m_size);
+	return n_pos;
+}
+
+std::streamsize FReadOnlyMemoryStreamBuf::showmanyc()
+{
+	const std::streamsize remaining = egptr() - gptr();
+	return remaining ? remaining : -1;
+}
+
+std::streamsize FReadOnlyMemoryStreamBuf::xsgetn(char_type *n_dest, std::streamsize n_count)
+{
+	const std::streamsize n = FMath::Min<std::streamsize>(n_count, egptr() - gptr());
+	if (n > 0)
+	{
+		std::memcpy(n_dest, gptr(), static_cast<size_t>(n));
+
+		// not gbump() as that takes an int and payloads may be larger than that
+		setg(eback(), gptr() + n, egptr());
+	}
+
+	return n;
+}
+
+FReadOnlyMemoryStreamBuf::int_type FReadOnlyMemoryStreamBuf::underflow()
+{
+	// The whole buffer is the get area, so once we're here there's nothing left
+	return (gptr() < egptr()) ? traits_type::to_int_type(*gptr()) : traits_type::eof();
+}
+
+FReadOnlyMemoryStreamBuf::int_type FReadOnlyMemoryStreamBuf::overflow(int_type /*n_ch*/)
+{
+	return traits_type::eof();
+}
+
+FReadOnlyMemoryStream::FReadOnlyMemoryStream(const unsigned char *n_data, const uint64 n_size)
+		: Aws::IOStream{ nullptr }
+		, m_buf{ n_data, n_size }
+{
+	rdbuf(&m_buf);
+}
+
+FReadOnlyMemoryStream::FReadOnlyMemoryStream(TUniquePtr<unsigned char []> &&n_data, const uint64 n_size)
+		: Aws::IOStream{ nullptr }
+		, m_owned{ MoveTemp(n_data) }
+		, m_buf{ m_owned.Get(), n_size }
+{
+	rdbuf(&m_buf);
+}
+
+FMemoryRangeStreamBuf::FMemoryRangeStreamBuf(unsigned char *n_data, const uint64 n_size)
+		: m_begin{ reinterpret_cast<char *>(n_data) }
+		, m_size{ n_size }
+{
+	setp(m_begin, m_begin + m_size);
+}
+
+FMemoryRangeStreamBuf::pos_type FMemoryRangeStreamBuf::seekoff(off_type n_off, std::ios_base::seekdir n_dir, std::ios_base::openmode n_which)
+{
+	if (n_which & std::ios_base::in)
+	{
+		return pos_type(off_type(-1));
+	}
+
+	off_type base = 0;
+	switch (n_dir)
+	{
+		case std::ios_base::beg:
+			base = 0;
+			break;
+		case std::ios_base::cur:
+			base = pptr() - pbase();
+			break;
+		case std::ios_base::end:
+			base = static_cast<off_type>(m_size);
+			break;
+		default:
+			return pos_type(off_type(-1));
+	}
+
+	return seekpos(pos_type(base + n_off), n_which);
+}
+
+FMemoryRangeStreamBuf::pos_type FMemoryRangeStreamBuf::seekpos(pos_type n_pos, std::ios_base::openmode n_which)
+{
+	const off_type pos = static_cast<off_type>(n_pos);
+	if ((n_which & std::ios_base::in) || pos < 0 || static_cast<uint64>(pos) > m_size)
+	{
+		return pos_type(off_type(-1));
+	}
+
+	setp(m_begin, m_begin + m_size);
+	advance(static_cast<uint64>(pos));
+	return n_pos;
+}
+
+void FMemoryRangeStreamBuf::advance(uint64 n_bytes) noexcept
+{
+	// pbump() takes an int and ranges may be larger than that
+	while (n_bytes)
+	{
+		const int step = static_cast<int>(FMath::Min<uint64>(n_bytes, MAX_int32));
+		pbump(step);
+		n_bytes -= step;
+	}
+}
+
+std::streamsize FMemoryRangeStreamBuf::xsputn(const char_type *n_source, std::streamsize n_count)
+{
+	const std::streamsize n = FMath::Min<std::streamsize>(n_count, epptr() - pptr());
+	if (n > 0)
+	{
+		std::memcpy(pptr(), n_source, static_cast<size_t>(n));
+		advance(static_cast<uint64>(n));
+	}
+
+	return n;
+}
+
+FMemoryRangeStreamBuf::int_type FMemoryRangeStreamBuf::overflow(int_type /*n_ch*/)
+{
+	return traits_type::eof();
+}
+
+FMemoryRangeStream::FMemoryRangeStream(unsigned char *n_data, const uint64 n_size)
+		: Aws::IOStream{ nullptr }
+		, m_buf{ n_data, n_size }
+{
+	rdbuf(&m_buf);
+}
+
+FSharedWriteFile::FSharedWriteFile(TUniquePtr<IFileHandle> &&n_file)
+		: m_file{ MoveTemp(n_file) }
+{
+}
+
+bool FSharedWriteFile::write(const uint64 n_offset, const char *n_data, const uint64 n_size) noexcept
+{
+	FScopeLock lock(&m_mutex);
+	if (!m_file || !m_file->Seek(static_cast<int64>(n_offset))
+			|| !m_file->Write(reinterpret_cast<const uint8 *>(n_data), static_cast<int64>(n_size)))
+	{
+		m_failed = true;
+		return false;
+	}
+
+	return true;
+}
+
+bool FSharedWriteFile::failed() const noexcept
+{
+	FScopeLock lock(&m_mutex);
+	return m_failed;
+}
+
+FFileRangeStreamBuf::FFileRangeStreamBuf(FSharedWriteFile &n_file, const uint64 n_offset, const uint64 n_size)
+		: m_file{ n_file }
+		, m_offset{ n_offset }
+		, m_size{ n_size }
+{
+	m_buffer.SetNumUninitialized(static_cast<int32>(FMath::Max<uint64>(FMath::Min<uint64>(m_size, s_file_range_buffer_bytes), 1)));
+	setp(m_buffer.GetData(), m_buffer.GetData() + m_buffer.Num());
+}
+
+FFileRangeStreamBuf::~FFileRangeStreamBuf() noexcept
+{
+	write_buffer();
+}
+
+FFileRangeStreamBuf::pos_type FFileRangeStreamBuf::seekoff(off_type n_off, std::ios_base::seekdir n_dir, std::ios_base::openmode n_which)
+{
+	if ((n_which & std::ios_base::in) || n_off != 0 || n_dir != std::ios_base::cur)
+	{
+		return pos_type(off_type(-1));
+	}
+
+	return pos_type(static_cast<off_type>(m_written + (pptr() - pbase())));
+}
+
+FFileRangeStreamBuf::int_type FFileRangeStreamBuf::overflow(int_type n_ch)
+{
+	if (!write_buffer())
+	{
+		return traits_type::eof();
+	}
+
+	if (!traits_type::eq_int_type(n_ch, traits_type::eof()))
+	{
+		*pptr() = traits_type::to_char_type(n_ch);
+		pbump(1);
+	}
+
+	return traits_type::not_eof(n_ch);
+}
+
+int FFileRangeStreamBuf::sync()
+{
+	return write_buffer() ? 0 : -1;
+}
+
+bool FFileRangeStreamBuf::write_buffer() noexcept
+{
+	const uint64 pending = static_cast<uint64>(pptr() - pbase());
+	if (!pending)
+	{
+		return true;
+	}
+
+	if (m_written + pending > m_size || !m_file.write(m_offset + m_written, pbase(), pending))
+	{
+		return false;
+	}
+
+	m_written += pending;
+	setp(m_buffer.GetData(), m_buffer.GetData() + m_buffer.Num());
+	return true;
+}
+
+FFileRangeStream::FFileRangeStream(FSharedWriteFile &n_file, const uint64 n_offset, const uint64 n_size)
+		: Aws::IOStream{ nullptr }
+		, m_buf{ n_file, n_offset, n_size }
+{
+	rdbuf(&m_buf);
+}
@@ -0,0 +1,189 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Templates/UniquePtr.h"
+#include "GenericPlatform/GenericPlatformFile.h"
+#include "HAL/CriticalSection.h"
+
+#include "Windows/PreWindowsApi.h"
+#include <aws/core/Aws.h>
+#include <aws/core/utils/memory/stl/AWSStreamFwd.h>
+#include "Windows/PostWindowsApi.h"
+
+#include <iostream>
+#include <streambuf>
+
+/*!
+ * A read-only, seekable streambuf directly over a block of memory.
+ * Modelled after Aws::Utils::Stream::PreallocatedStreamBuf but never writes,
+ * never copies on its own and answers size and remaining bytes right away,
+ * so the SDK can hash and send the payload without probing the stream.
+ * The memory is borrowed and must outlive the streambuf.
+ */
+class FReadOnlyMemoryStreamBuf : public std::streambuf
+{
+	public:
+		FReadOnlyMemoryStreamBuf(const unsigned char *n_data, const uint64 n_size);
+
+		FReadOnlyMemoryStreamBuf(const FReadOnlyMemoryStreamBuf &) = delete;
+		FReadOnlyMemoryStreamBuf &operator=(const FReadOnlyMemoryStreamBuf &) = delete;
+
+		uint64 size() const noexcept { return m_size; }
+
+	protected:
+		pos_type seekoff(off_type n_off, std::ios_base::seekdir n_dir, std::ios_base::openmode n_which = std::ios_base::in) override;
+		pos_type seekpos(pos_type n_pos, std::ios_base::openmode n_which = std::ios_base::in) override;
+
+		std::streamsize showmanyc() override;
+		std::streamsize xsgetn(char_type *n_dest, std::streamsize n_count) override;
+		int_type underflow() override;
+
+		/// read-only
+		int_type overflow(int_type n_ch) override;
+
+	private:
+		char         *m_begin;
+		const uint64  m_size;
+};
+
+/*!
+ * The SDK insists on Aws::IOStream as request body even though it only reads.
+ * This one owns a FReadOnlyMemoryStreamBuf over borrowed memory and refuses writes.
+ */
+class FReadOnlyMemoryStream : public Aws::IOStream
+{
+	public:
+		/// borrow n_size bytes at n_data, which must outlive the stream
+		FReadOnlyMemoryStream(const unsigned char *n_data, const uint64 n_size);
+
+		/// take ownership over the buffer
+		FReadOnlyMemoryStream(TUniquePtr<unsigned char []> &&n_data, const uint64 n_size);
+
+		/// payload size, to be given to the request as content length
+		uint64 size() const noexcept { return m_buf.size(); }
+
+	private:
+		TUniquePtr<unsigned char []>   m_owned;
+		FReadOnlyMemoryStreamBuf       m_buf;
+};
+
+/*!
+ * A write-only streambuf over a fixed block of memory, for response bodies to be
+ * received right where they belong, like one range of a larger download.
+ * Writing past the end fails the stream instead of growing anything.
+ * The memory is borrowed and must outlive the streambuf.
+ */
+class FMemoryRangeStreamBuf : public std::streambuf
+{
+	public:
+		FMemoryRangeStreamBuf(unsigned char *n_data, const uint64 n_size);
+
+		FMemoryRangeStreamBuf(const FMemoryRangeStreamBuf &) = delete;
+		FMemoryRangeStreamBuf &operator=(const FMemoryRangeStreamBuf &) = delete;
+
+		/// bytes written from the beginning
+		uint64 written() const noexcept { return static_cast<uint64>(pptr() - pbase()); }
+
+	protected:
+		pos_type seekoff(off_type n_off, std::ios_base::seekdir n_dir, std::ios_base::openmode n_which = std::ios_base::out) override;
+		pos_type seekpos(pos_type n_pos, std::ios_base::openmode n_which = std::ios_base::out) override;
+
+		std::streamsize xsputn(const char_type *n_source, std::streamsize n_count) override;
+
+		/// only reached when the block is full
+		int_type overflow(int_type n_ch) override;
+
+	private:
+		void advance(uint64 n_bytes) noexcept;
+
+		char         *m_begin;
+		const uint64  m_size;
+};
+
+/*!
+ * Response stream for the SDK, writing into borrowed memory through a FMemoryRangeStreamBuf
+ */
+class FMemoryRangeStream : public Aws::IOStream
+{
+	public:
+		/// receive up to n_size bytes at n_data, which must outlive the stream
+		FMemoryRangeStream(unsigned char *n_data, const uint64 n_size);
+
+		uint64 written() const noexcept { return m_buf.written(); }
+
+	private:
+		FMemoryRangeStreamBuf          m_buf;
+};
+
+/*!
+ * One file several range streams write into at once, each at its own offset.
+ * Owns the handle, as platforms may not allow more than one writer per file.
+ * Writes are serialized. Remembers whether any of them failed.
+ */
+class FSharedWriteFile
+{
+	public:
+		explicit FSharedWriteFile(TUniquePtr<IFileHandle> &&n_file);
+
+		FSharedWriteFile(const FSharedWriteFile &) = delete;
+		FSharedWriteFile &operator=(const FSharedWriteFile &) = delete;
+
+		bool write(const uint64 n_offset, const char *n_data, const uint64 n_size) noexcept;
+
+		bool failed() const noexcept;
+
+	private:
+		mutable FCriticalSection  m_mutex;
+		TUniquePtr<IFileHandle>   m_file;
+		bool                      m_failed = false;
+};
+
+/*!
+ * A write-only streambuf for one byte range of a FSharedWriteFile.
+ * Collects the bytes in a buffer of its own and writes them at the range's offset
+ * when it's full and on sync. Refuses bytes beyond the range.
+ * The file is borrowed and must outlive the streambuf.
+ */
+class FFileRangeStreamBuf : public std::streambuf
+{
+	public:
+		FFileRangeStreamBuf(FSharedWriteFile &n_file, const uint64 n_offset, const uint64 n_size);
+		~FFileRangeStreamBuf() noexcept;
+
+		FFileRangeStreamBuf(const FFileRangeStreamBuf &) = delete;
+		FFileRangeStreamBuf &operator=(const FFileRangeStreamBuf &) = delete;
+
+	protected:
+		/// only tells the position
+		pos_type seekoff(off_type n_off, std::ios_base::seekdir n_dir, std::ios_base::openmode n_which = std::ios_base::out) override;
+
+		int_type overflow(int_type n_ch) override;
+		int sync() override;
+
+	private:
+		/// write what's buffered, false if that failed or exceeds the range
+		bool write_buffer() noexcept;
+
+		FSharedWriteFile  &m_file;
+		const uint64       m_offset;
+		const uint64       m_size;
+		uint64             m_written = 0;
+		TArray<char>       m_buffer;
+};
+
+/*!
+ * Response stream for the SDK, writing one range into a file through a FFileRangeStreamBuf
+ */
+class FFileRangeStream : public Aws::IOStream
+{
+	public:
+		/// receive up to n_size bytes to be written at n_offset of n_file, which must outlive the stream
+		FFileRangeStream(FSharedWriteFile &n_file, const uint64 n_offset, const uint64 n_size);
+
+	private:
+		FFileRangeStreamBuf            m_buf;
+};
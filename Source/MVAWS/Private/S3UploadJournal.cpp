@@ -0,0 +1,258 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#include "S3UploadJournal.h"
+#include "Utils.h"
+
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+// AWS SDK
+#include "Windows/PreWindowsApi.h"
+#include <aws/s3/S3Client.h>
+#include <aws/s3/S3Errors.h>
+#include <aws/s3/model/AbortMultipartUploadRequest.h>
+#include "Windows/PostWindowsApi.h"
+
+using namespace Aws::S3::Model;
+
+namespace {
+
+const TCHAR *s_journal_extension = TEXT(".journal");
+
+// One field per line, "name=value". Values run to the end of the line
+const FString s_bucket{ TEXT("bucket") };
+const FString s_key{ TEXT("key") };
+const FString s_file{ TEXT("file") };
+const FString s_size{ TEXT("size") };
+const FString s_modified{ TEXT("modified") };
+const FString s_created{ TEXT("created") };
+const FString s_upload_id{ TEXT("upload_id") };
+const FString s_part_size{ TEXT("part_size") };
+const FString s_part{ TEXT("part") };      // "part=<number> <etag>", one per completed part
+
+FString field(const FString &n_name, const FString &n_value)
+{
+	return n_name + TEXT("=") + n_value + TEXT("\n");
+}
+
+/// fields of an entry as written, empty if it can't be read
+TMap<FString, FString> read_fields(const FString &n_path, TArray<FString> *n_parts = nullptr)
+{
+	TMap<FString, FString> fields;
+
+	TArray<FString> lines;
+	if (!FFileHelper::LoadFileToStringArray(lines, *n_path))
+	{
+		return fields;
+	}
+
+	for (const FString &line : lines)
+	{
+		FString name, value;
+		if (!line.Split(TEXT("="), &name, &value))
+		{
+			// torn last line of a crashed process
+			continue;
+		}
+
+		if (name == s_part)
+		{
+			if (n_parts)
+			{
+				n_parts->Add(value);
+			}
+		}
+		else
+		{
+			fields.Add(name, value);
+		}
+	}
+
+	return fields;
+}
+
+bool abort_upload(Aws::S3::S3Client &n_client, const FString &n_bucket, const FString &n_key, const FString &n_upload_id)
+{
+	AbortMultipartUploadRequest request;
+	request.SetBucket(TCHAR_TO_UTF8(*n_bucket));
+	request.SetKey(TCHAR_TO_UTF8(*n_key));
+	request.SetUploadId(TCHAR_TO_UTF8(*n_upload_id));
+
+	const AbortMultipartUploadOutcome outcome = n_client.AbortMultipartUpload(request);
+	if (outcome.IsSuccess() || outcome.GetError().GetErrorType() == Aws::S3::S3Errors::NO_SUCH_UPLOAD)
+	{
+		return true;
+	}
+
+	UE_LOG(LogMVAWS, Warning, TEXT("Failed to abort expired multipart upload of object '%s': %s"), *n_key,
+			UTF8_TO_TCHAR(outcome.GetError().GetMessage().c_str()));
+	return false;
+}
+
+}
+
+FS3UploadJournal::FS3UploadJournal(const FString &n_directory, const FS3UploadTarget &n_target,
+		const FString &n_file_path, const FTimespan &n_ttl)
+		: m_path{ FPaths::Combine(n_directory, md5_utf8(FString::Printf(TEXT("%s\n%s\n%s"),
+				*n_target.BucketName, *n_target.ObjectKey, *n_file_path)) + s_journal_extension) }
+		, m_target{ n_target }
+		, m_file_path{ n_file_path }
+		, m_ttl{ n_ttl }
+{
+	IPlatformFile &platform_file = FPlatformFileManager::Get().GetPlatformFile();
+	m_file_size = platform_file.FileSize(*m_file_path);
+	m_file_modified = platform_file.GetTimeStamp(*m_file_path);
+
+	if (!load())
+	{
+		m_upload_id.clear();
+		m_part_size = 0;
+		m_parts.Reset();
+	}
+}
+
+bool FS3UploadJournal::load()
+{
+	TArray<FString> parts;
+	const TMap<FString, FString> fields = read_fields(m_path, &parts);
+	if (fields.IsEmpty())
+	{
+		return false;
+	}
+
+	// Same target, same file, same contents as far as we can tell
+	const auto is = [&fields](const FString &n_name, const FString &n_value) {
+		const FString *value = fields.Find(n_name);
+		return value && *value == n_value;
+	};
+
+	if (!is(s_bucket, m_target.BucketName) || !is(s_key, m_target.ObjectKey) || !is(s_file, m_file_path)
+			|| !is(s_size, LexToString(m_file_size)) || !is(s_modified, LexToString(m_file_modified.GetTicks())))
+	{
+		return false;
+	}
+
+	const FString *upload_id = fields.Find(s_upload_id);
+	const FString *part_size = fields.Find(s_part_size);
+	const FString *created = fields.Find(s_created);
+	if (!upload_id || upload_id->IsEmpty() || !part_size || !created)
+	{
+		return false;
+	}
+
+	m_upload_id = TCHAR_TO_UTF8(**upload_id);
+	m_part_size = FCString::Strtoui64(**part_size, nullptr, 10);
+	m_created = FDateTime{ FCString::Atoi64(**created) };
+
+	for (const FString &part : parts)
+	{
+		FString number, etag;
+		if (part.Split(TEXT(" "), &number, &etag) && !etag.IsEmpty())
+		{
+			m_parts.Add(FCString::Atoi(*number), Aws::String{ TCHAR_TO_UTF8(*etag) });
+		}
+	}
+
+	return m_part_size > 0;
+}
+
+bool FS3UploadJournal::is_expired() const noexcept
+{
+	return !m_upload_id.empty() && FDateTime::UtcNow() - m_created > m_ttl;
+}
+
+bool FS3UploadJournal::begin(const Aws::String &n_upload_id, const uint64 n_part_size)
+{
+	const FDateTime created = FDateTime::UtcNow();
+
+	const FString entry = field(s_bucket, m_target.BucketName)
+			+ field(s_key, m_target.ObjectKey)
+			+ field(s_file, m_file_path)
+			+ field(s_size, LexToString(m_file_size))
+			+ field(s_modified, LexToString(m_file_modified.GetTicks()))
+			+ field(s_created, LexToString(created.GetTicks()))
+			+ field(s_upload_id, UTF8_TO_TCHAR(n_upload_id.c_str()))
+			+ field(s_part_size, LexToString(n_part_size));
+
+	// Whatever was recorded before is void either way
+	m_upload_id.clear();
+	m_part_size = 0;
+	m_parts.Reset();
+
+	FPlatformFileManager::Get().GetPlatformFile().CreateDirectoryTree(*FPaths::GetPath(m_path));
+	if (!FFileHelper::SaveStringToFile(entry, *m_path, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM))
+	{
+		UE_LOG(LogMVAWS, Warning, TEXT("Cannot write upload journal '%s', upload of object '%s' can't be resumed"),
+				*m_path, *m_target.ObjectKey);
+		return false;
+	}
+
+	// Only known once it's on disk
+	m_upload_id = n_upload_id;
+	m_part_size = n_part_size;
+	m_created = created;
+	return true;
+}
+
+void FS3UploadJournal::part_done(const int32 n_part_number, const Aws::String &n_etag)
+{
+	m_parts.Add(n_part_number, n_etag);
+
+	FFileHelper::SaveStringToFile(field(s_part, FString::Printf(TEXT("%i %s"), n_part_number, UTF8_TO_TCHAR(n_etag.c_str()))),
+			*m_path, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM, &IFileManager::Get(), FILEWRITE_Append);
+}
+
+void FS3UploadJournal::remove()
+{
+	m_upload_id.clear();
+	m_part_size = 0;
+	m_parts.Reset();
+
+	FPlatformFileManager::Get().GetPlatformFile().DeleteFile(*m_path);
+}
+
+void FS3UploadJournal::abort_expired(Aws::S3::S3Client &n_client, const FString &n_directory, const FTimespan &n_ttl)
+{
+	TArray<FString> files;
+	IFileManager::Get().FindFiles(files, *n_directory, s_journal_extension);
+
+	IPlatformFile &platform_file = FPlatformFileManager::Get().GetPlatformFile();
+	const FDateTime now = FDateTime::UtcNow();
+	int32 aborted = 0;
+
+	for (const FString &file : files)
+	{
+		const FString path = FPaths::Combine(n_directory, file);
+		const TMap<FString, FString> fields = read_fields(path);
+
+		// An entry without a creation time may be one begin() is rewriting right now.
+		// Only once it stayed that way for longer than the TTL is it really of no use
+		const FString *created = fields.Find(s_created);
+		const FDateTime written = created ? FDateTime{ FCString::Atoi64(**created) } : platform_file.GetTimeStamp(*path);
+		if (now - written <= n_ttl)
+		{
+			continue;
+		}
+
+		const FString *bucket = fields.Find(s_bucket);
+		const FString *key = fields.Find(s_key);
+		const FString *upload_id = fields.Find(s_upload_id);
+		if (bucket && key && upload_id && !upload_id->IsEmpty() && !abort_upload(n_client, *bucket, *key, *upload_id))
+		{
+			// try again next time
+			continue;
+		}
+
+		platform_file.DeleteFile(*path);
+		aborted++;
+	}
+
+	if (aborted)
+	{
+		UE_LOG(LogMVAWS, Display, TEXT("Aborted %i expired multipart uploads"), aborted);
+	}
+}
@@ -0,0 +1,85 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#pragma once
+
+#include "CoreMinimal.h"
+#include "IMVAWS.h"
+#include "Misc/DateTime.h"
+#include "Misc/Timespan.h"
+
+#include "Windows/PreWindowsApi.h"
+#include <aws/core/Aws.h>
+#include <aws/core/utils/memory/stl/AWSString.h>
+#include "Windows/PostWindowsApi.h"
+
+namespace Aws::S3 {
+	class S3Client;
+}
+
+/*!
+ * Local record of a multipart upload of a file, so it can be continued after
+ * a failure or a restart instead of being sent again from the start.
+ * One small text file per upload holds the target, size and modification time of
+ * the source file, the upload id, the part size and the ETags of completed parts.
+ * Completed parts are appended as they come in.
+ * An entry is only picked up again for the same file with unchanged contents.
+ * Not thread safe, used by the thread running the upload.
+ */
+class FS3UploadJournal
+{
+	public:
+		/*!
+		 * Look for an entry of an earlier attempt to upload this file to this target. Blocking file IO.
+		 * \param n_directory where entries are kept
+		 * \param n_ttl entries older than this aren't continued
+		 */
+		FS3UploadJournal(const FString &n_directory, const FS3UploadTarget &n_target,
+				const FString &n_file_path, const FTimespan &n_ttl);
+
+		/// upload id of an earlier attempt, empty if there is none
+		const Aws::String &upload_id() const noexcept { return m_upload_id; }
+
+		/// part size of the earlier attempt. Must be kept when continuing
+		uint64 part_size() const noexcept { return m_part_size; }
+
+		/// ETags of parts completed earlier by part number, as far as we know
+		const TMap<int32, Aws::String> &parts() const noexcept { return m_parts; }
+
+		/// the earlier attempt is older than the TTL. It should be aborted instead of continued
+		bool is_expired() const noexcept;
+
+		/// A new multipart upload was created. Replaces what was recorded before
+		bool begin(const Aws::String &n_upload_id, const uint64 n_part_size);
+
+		/// A part made it to S3
+		void part_done(const int32 n_part_number, const Aws::String &n_etag);
+
+		/// The upload was completed or aborted. Deletes the entry
+		void remove();
+
+		/*!
+		 * Abort multipart uploads of entries older than n_ttl and delete those entries.
+		 * Meant to clean up after processes which never came back to their uploads.
+		 * Blocking.
+		 */
+		static void abort_expired(Aws::S3::S3Client &n_client, const FString &n_directory, const FTimespan &n_ttl);
+
+	private:
+		/// read the entry, false if there is none or it doesn't match
+		bool load();
+
+		const FString             m_path;
+		const FS3UploadTarget     m_target;
+		const FString             m_file_path;
+		const FTimespan           m_ttl;
+
+		int64                     m_file_size = -1;
+		FDateTime                 m_file_modified;
+
+		Aws::String               m_upload_id;
+		uint64                    m_part_size = 0;
+		FDateTime                 m_created;
+		TMap<int32, Aws::String>  m_parts;
+};
@@ -0,0 +1,101 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#include "S3UploadScheduler.h"
+#include "IMVAWS.h"
+
+// Engine
+#include "HAL/Event.h"
+#include "HAL/PlatformProcess.h"
+#include "Misc/ScopeLock.h"
+
+namespace
+{
+
+/// The SDK and the http stack underneath want a little more than the engine default
+constexpr uint32 s_upload_thread_stack_size = 256 * 1024;
+
+} // anon ns
+
+FS3UploadScheduler::FS3UploadScheduler(const uint32 n_max_concurrent, const uint64 n_byte_budget)
+		: m_byte_budget{ n_byte_budget }
+{
+	m_released = FPlatformProcess::GetSynchEventFromPool(false);
+
+	m_pool = FQueuedThreadPool::Allocate();
+	verifyf(m_pool->Create(FMath::Max(n_max_concurrent, 1u), s_upload_thread_stack_size, TPri_Normal, TEXT("MVAWS_S3Upload")),
+			TEXT("Failed to create S3 upload thread pool"));
+
+	UE_LOG(LogMVAWS, Display, TEXT("S3 upload scheduler running %u concurrent uploads with a budget of %llu bytes"),
+			FMath::Max(n_max_concurrent, 1u), m_byte_budget);
+}
+
+FS3UploadScheduler::~FS3UploadScheduler() noexcept
+{
+	if (m_pool)
+	{
+		// Queued non-abandonable tasks are run to completion in here
+		m_pool->Destroy();
+		delete m_pool;
+		m_pool = nullptr;
+	}
+
+	FPlatformProcess::ReturnSynchEventToPool(m_released);
+	m_released = nullptr;
+}
+
+bool FS3UploadScheduler::try_reserve(const uint64 n_bytes) noexcept
+{
+	FScopeLock slock(&m_mutex);
+
+	if (m_buffered_bytes && (m_buffered_bytes + n_bytes > m_byte_budget))
+	{
+		return false;
+	}
+
+	m_buffered_bytes += n_bytes;
+	return true;
+}
+
+bool FS3UploadScheduler::reserve(const uint64 n_bytes, const FTimespan &n_max_wait) noexcept
+{
+	const double deadline = FPlatformTime::Seconds() + n_max_wait.GetTotalSeconds();
+
+	while (!try_reserve(n_bytes))
+	{
+		const double remaining = deadline - FPlatformTime::Seconds();
+		if (remaining <= 0.0)
+		{
+			return false;
+		}
+
+		// There may be more than one waiter but the event only wakes one of them.
+		// Hence waiting in slices rather than relying on being woken up.
+		m_released->Wait(FTimespan::FromSeconds(FMath::Min(remaining, 0.1)));
+	}
+
+	return true;
+}
+
+void FS3UploadScheduler::release(const uint64 n_bytes) noexcept
+{
+	{
+		FScopeLock slock(&m_mutex);
+		checkf(m_buffered_bytes >= n_bytes, TEXT("Releasing more upload buffer bytes than were reserved"));
+		m_buffered_bytes -= n_bytes;
+	}
+
+	m_released->Trigger();
+}
+
+uint64 FS3UploadScheduler::buffered_bytes() const noexcept
+{
+	FScopeLock slock(&m_mutex);
+	return m_buffered_bytes;
+}
+
+FQueuedThreadPool *FS3UploadScheduler::pool() const noexcept
+{
+	return m_pool;
+}
@@ -0,0 +1,65 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/QueuedThreadPool.h"
+#include "Misc/Timespan.h"
+#include "HAL/CriticalSection.h"
+
+/*!
+ * Runs S3 uploads on a thread pool of its own so blocking HTTP calls don't
+ * occupy the engine's GThreadPool. The number of pool threads is the number
+ * of uploads that can be active at the same time, the rest queues up.
+ *
+ * In addition it keeps account of how many bytes of memory buffers are
+ * held by queued and running uploads. Callers reserve their payload size
+ * before queueing and release it when the buffer is gone.
+ */
+class FS3UploadScheduler
+{
+	public:
+		FS3UploadScheduler(const uint32 n_max_concurrent, const uint64 n_byte_budget);
+
+		/// Finishes all queued uploads (blocking) and tears down the pool
+		~FS3UploadScheduler() noexcept;
+
+		FS3UploadScheduler(const FS3UploadScheduler &) = delete;
+		FS3UploadScheduler &operator=(const FS3UploadScheduler &) = delete;
+
+		/*!
+		 * Reserve n_bytes of the budget if available.
+		 * A payload larger than the entire budget is admitted only when nothing
+		 * else is buffered, so it can't get stuck forever.
+		 * \return false if the budget is exhausted, nothing was reserved
+		 */
+		bool try_reserve(const uint64 n_bytes) noexcept;
+
+		/*!
+		 * Like try_reserve() but waits up to n_max_wait for other uploads
+		 * to release their buffers.
+		 * \return false if the budget was still exhausted after n_max_wait
+		 */
+		bool reserve(const uint64 n_bytes, const FTimespan &n_max_wait) noexcept;
+
+		/// Give back what was reserved before. Wakes up waiters
+		void release(const uint64 n_bytes) noexcept;
+
+		/// What's currently held by queued and running uploads
+		uint64 buffered_bytes() const noexcept;
+
+		/// Queue upload tasks in here
+		FQueuedThreadPool *pool() const noexcept;
+
+	private:
+		FQueuedThreadPool       *m_pool = nullptr;
+		const uint64             m_byte_budget;
+
+		mutable FCriticalSection m_mutex;
+		uint64                   m_buffered_bytes = 0;    //!< protected by m_mutex
+
+		/// Triggered each time bytes are released
+		FEvent                  *m_released = nullptr;
+};
@@ -0,0 +1,156 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#include "SQSDeleteBatcher.h"
+#include "IMVAWS.h"
+
+// Engine
+#include "HAL/Event.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+
+// AWS SDK
+#include "Windows/PreWindowsApi.h"
+#include <aws/sqs/SQSClient.h>
+#include <aws/sqs/model/DeleteMessageRequest.h>
+#include <aws/sqs/model/DeleteMessageBatchRequest.h>
+#include <aws/sqs/model/DeleteMessageBatchRequestEntry.h>
+#include <aws/sqs/model/DeleteMessageBatchResult.h>
+#include "Windows/PostWindowsApi.h"
+
+using namespace Aws::SQS::Model;
+
+namespace
+{
+
+/// SQS takes no more than this many entries in a batch call
+constexpr int32 s_max_batch_size = 10;
+
+/// How long an acknowledgement may wait for others to join its batch (seconds)
+constexpr double s_flush_interval = 0.1;
+
+} // anon ns
+
+FSQSDeleteBatcher::FSQSDeleteBatcher(const TSharedPtr<Aws::SQS::SQSClient, ESPMode::ThreadSafe> &n_sqs, const Aws::String &n_queue_url)
+		: m_sqs{ n_sqs }
+		, m_queue_url{ n_queue_url }
+{
+	m_wake = FPlatformProcess::GetSynchEventFromPool(false);
+	m_thread = MakeUnique<FThread>(TEXT("AWS_SQS_Delete"), [this] { this->delete_thread(); });
+}
+
+FSQSDeleteBatcher::~FSQSDeleteBatcher() noexcept
+{
+	m_stop.Store(true);
+	m_wake->Trigger();
+	m_thread->Join();
+	m_thread.Reset();
+
+	FPlatformProcess::ReturnSynchEventToPool(m_wake);
+	m_wake = nullptr;
+}
+
+void FSQSDeleteBatcher::enqueue(const Aws::String &n_message_id, const Aws::String &n_receipt_handle) noexcept
+{
+	m_queue.Enqueue(pending_delete{ n_message_id, n_receipt_handle, FPlatformTime::Seconds() });
+	m_wake->Trigger();
+}
+
+void FSQSDeleteBatcher::delete_thread() noexcept
+{
+	TArray<pending_delete> batch;
+	batch.Reserve(s_max_batch_size);
+
+	while (true)
+	{
+		// read before draining so nothing enqueued before the stop is left behind
+		const bool stopping = m_stop;
+
+		pending_delete next;
+		while (batch.Num() < s_max_batch_size && m_queue.Dequeue(next))
+		{
+			batch.Add(MoveTemp(next));
+		}
+
+		const double waited = batch.IsEmpty() ? 0.0 : FPlatformTime::Seconds() - batch[0].m_queued;
+		if (batch.Num() == s_max_batch_size || (!batch.IsEmpty() && (stopping || waited >= s_flush_interval)))
+		{
+			flush(batch);
+			batch.Reset();
+			continue;
+		}
+
+		if (stopping && batch.IsEmpty())
+		{
+			break;
+		}
+
+		// Sleep until more come in or the oldest one is due
+		const double timeout = batch.IsEmpty() ? 1.0 : s_flush_interval - waited;
+		m_wake->Wait(FTimespan::FromSeconds(timeout));
+	}
+}
+
+void FSQSDeleteBatcher::flush(const TArray<pending_delete> &n_batch) const noexcept
+{
+	DeleteMessageBatchRequest request;
+	request.SetQueueUrl(m_queue_url);
+
+	// Entry IDs are indices into the batch
+	for (int32 i = 0; i < n_batch.Num(); ++i)
+	{
+		DeleteMessageBatchRequestEntry entry;
+		entry.SetId(TCHAR_TO_UTF8(*FString::FromInt(i)));
+		entry.SetReceiptHandle(n_batch[i].m_receipt_handle);
+		request.AddEntries(MoveTemp(entry));
+	}
+
+	TArray<int32> retry;
+
+	const DeleteMessageBatchOutcome outcome = m_sqs->DeleteMessageBatch(request);
+	if (outcome.IsSuccess())
+	{
+		UE_LOG(LogMVAWS, Display, TEXT("Deleted %i of %i messages"),
+			static_cast<int32>(outcome.GetResult().GetSuccessful().size()), n_batch.Num());
+
+		for (const BatchResultErrorEntry &failure : outcome.GetResult().GetFailed())
+		{
+			const int32 i = FCString::Atoi(UTF8_TO_TCHAR(failure.GetId().c_str()));
+			if (n_batch.IsValidIndex(i))
+			{
+				UE_LOG(LogMVAWS, Warning, TEXT("Batch deletion of message '%s' failed, retrying: %s"),
+					UTF8_TO_TCHAR(n_batch[i].m_message_id.c_str()), UTF8_TO_TCHAR(failure.GetMessage().c_str()));
+				retry.Add(i);
+			}
+		}
+	}
+	else
+	{
+		UE_LOG(LogMVAWS, Warning, TEXT("Batch deletion of %i messages failed, retrying one by one: %s"),
+			n_batch.Num(), UTF8_TO_TCHAR(outcome.GetError().GetMessage().c_str()));
+
+		for (int32 i = 0; i < n_batch.Num(); ++i)
+		{
+			retry.Add(i);
+		}
+	}
+
+	for (const int32 i : retry)
+	{
+		DeleteMessageRequest single;
+		single.SetQueueUrl(m_queue_url);
+		single.SetReceiptHandle(n_batch[i].m_receipt_handle);
+
+		const DeleteMessageOutcome single_outcome = m_sqs->DeleteMessage(single);
+		if (single_outcome.IsSuccess())
+		{
+			UE_LOG(LogMVAWS, Display, TEXT("Deleted message '%s'"), UTF8_TO_TCHAR(n_batch[i].m_message_id.c_str()));
+		}
+		else
+		{
+			UE_LOG(LogMVAWS, Error, TEXT("Deletion of message '%s' failed: %s"),
+				UTF8_TO_TCHAR(n_batch[i].m_message_id.c_str()), UTF8_TO_TCHAR(single_outcome.GetError().GetMessage().c_str()));
+		}
+	}
+}
@@ -0,0 +1,61 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Thread.h"
+#include "Containers/Queue.h"
+
+#include "Windows/PreWindowsApi.h"
+#include <aws/core/Aws.h>
+#include <aws/core/utils/memory/stl/AWSString.h>
+#include "Windows/PostWindowsApi.h"
+
+namespace Aws::SQS {
+	class SQSClient;
+}
+
+/*!
+ * Acknowledges SQS messages off the poll thread.
+ * Messages to be deleted are queued and a background thread deletes them with
+ * DeleteMessageBatch, either once a full batch of 10 is together or when the oldest
+ * has waited for a short while. Entries the batch call couldn't delete are
+ * retried one by one with DeleteMessage.
+ */
+class FSQSDeleteBatcher
+{
+	public:
+		FSQSDeleteBatcher(const TSharedPtr<Aws::SQS::SQSClient, ESPMode::ThreadSafe> &n_sqs, const Aws::String &n_queue_url);
+
+		/// Deletes everything still queued (blocking) and stops the thread
+		~FSQSDeleteBatcher() noexcept;
+
+		FSQSDeleteBatcher(const FSQSDeleteBatcher &) = delete;
+		FSQSDeleteBatcher &operator=(const FSQSDeleteBatcher &) = delete;
+
+		/// Queue a message for deletion. Returns right away. Single producer only
+		void enqueue(const Aws::String &n_message_id, const Aws::String &n_receipt_handle) noexcept;
+
+	private:
+		struct pending_delete {
+			Aws::String m_message_id;
+			Aws::String m_receipt_handle;
+			double      m_queued;          //!< FPlatformTime::Seconds()
+		};
+
+		void delete_thread() noexcept;
+
+		// one DeleteMessageBatch call, plus single retries of failed entries
+		void flush(const TArray<pending_delete> &n_batch) const noexcept;
+
+		const TSharedPtr<Aws::SQS::SQSClient, ESPMode::ThreadSafe> m_sqs;
+		const Aws::String                m_queue_url;
+
+		TQueue<pending_delete, EQueueMode::Spsc> m_queue;
+		FEvent                          *m_wake = nullptr;
+
+		TUniquePtr<FThread>              m_thread;
+		TAtomic<bool>                    m_stop{ false };
+};
@@ -8,6 +8,8 @@
 
 // Engine
 #include "Async/AsyncWork.h"
+#include "Async/Future.h"
+#include "HAL/Event.h"
 
 // AWS SDK
 #include "Windows/PreWindowsApi.h"
@@ -22,22 +24,53 @@
 #include <aws/sqs/SQSRequest.h>
 #include <aws/sqs/model/ReceiveMessageRequest.h>
 #include <aws/sqs/model/ReceiveMessageResult.h>
-#include <aws/sqs/model/DeleteMessageRequest.h>
 #include <aws/sqs/model/ChangeMessageVisibilityRequest.h>
+#include <aws/sqs/model/ChangeMessageVisibilityBatchRequest.h>
+#include <aws/sqs/model/ChangeMessageVisibilityBatchRequestEntry.h>
+#include <aws/sqs/model/ChangeMessageVisibilityBatchResult.h>
+#include <aws/sqs/model/GetQueueAttributesRequest.h>
+#include <aws/sqs/model/GetQueueAttributesResult.h>
 
 
 #include "Windows/PostWindowsApi.h"
 
 using namespace Aws::SQS::Model;
 
-void USQSImpl::set_parameters(const FString &n_queue_url, const unsigned int n_wait_time, const bool n_handle_on_game_thread) {
+namespace {
+
+// SQS won't give out more than this many messages per ReceiveMessage call
+// and takes no more than this many entries in a batch call
+const unsigned int s_max_batch_size = 10;
+
+// used when the queue's visibility timeout cannot be read
+const int s_default_visibility_timeout = 30;
+}
+
+struct FSQSPromiseSignal {
+
+	FSQSPromiseSignal()
+		: m_event{ FPlatformProcess::GetSynchEventFromPool(false) } {
+	}
+
+	~FSQSPromiseSignal() {
+		FPlatformProcess::ReturnSynchEventToPool(m_event);
+	}
+
+	FEvent *m_event;
+};
+
+void USQSImpl::set_parameters(const FString &n_queue_url, const unsigned int n_wait_time, const bool n_handle_on_game_thread,
+		const unsigned int n_prefetch_count, const bool n_visibility_heartbeat) {
 
 	m_queue_url = TCHAR_TO_UTF8(*n_queue_url);
 	m_long_poll_wait_time = n_wait_time;
 	m_handler_on_game_thread = n_handle_on_game_thread;
+	m_long_poll_max_msg = FMath::Clamp(n_prefetch_count, 1u, s_max_batch_size);
+	m_visibility_heartbeat = n_visibility_heartbeat;
+	m_visibility_timeout = 0;
 }
 
-bool USQSImpl::start_polling(FOnSQSMessageReceived &&n_delegate) {
+bool USQSImpl::start_polling(FOnSQSMessageReceived &&n_delegate, const int n_max_in_flight) {
 
 	stop_polling();
 	join();
@@ -60,7 +93,6 @@ bool USQSImpl::start_polling(FOnSQSMessageReceived &&n_delegate) {
 	client_config.httpRequestTimeoutMs = 7000;
 	client_config.requestTimeoutMs = 6000;
 
-	m_sqs = MakeShareable<Aws::SQS::SQSClient>(new Aws::SQS::SQSClient(client_config));
 	m_delegate = n_delegate;
 
 	if (!m_delegate.IsBound()) {
@@ -68,7 +100,11 @@ bool USQSImpl::start_polling(FOnSQSMessageReceived &&n_delegate) {
 		return false;
 	}
 
-	m_long_poll_max_msg = 1;
+	m_sqs = MakeShareable<Aws::SQS::SQSClient>(new Aws::SQS::SQSClient(client_config));
+	m_deleter = MakeUnique<FSQSDeleteBatcher>(m_sqs, m_queue_url);
+
+	m_max_in_flight = static_cast<unsigned int>(FMath::Max(n_max_in_flight, 1));
+	m_promise_set = MakeShared<FSQSPromiseSignal, ESPMode::ThreadSafe>();
 
 	m_poll_thread = MakeUnique<FThread>(TEXT("AWS_Long_Poll"), [this] { this->long_poll(); });
 
@@ -96,6 +132,11 @@ void USQSImpl::join() noexcept
 		m_poll_thread.Reset();
 	}
 
+	m_promise_set.Reset();
+
+	// The poll thread is gone, so all acknowledgements are queued. Flush them
+	m_deleter.Reset();
+
 	m_sqs.Reset();
 	m_delegate.Unbind();
 }
@@ -113,14 +154,50 @@ void USQSImpl::long_poll() noexcept
 			continue;
 		}
 
+		reap_in_flight();
+		extend_visibility(m_visibility_timeout / 3.0);
+
+		// All slots taken, wait for the delegate to finish something
+		if (static_cast<unsigned int>(m_in_flight.Num()) >= m_max_in_flight)
+		{
+			wait_for_in_flight();
+			continue;
+		}
+
+		// A slot is free. Serve it from the buffer if I can
+		if (!m_prefetched.IsEmpty())
+		{
+			// Messages that waited for a while get their full visibility timeout back
+			// before they go out, the handler shouldn't pay for our buffering
+			extend_visibility(m_visibility_timeout * 2.0 / 3.0);
+
+			const FSQSPrefetchedMessage next = m_prefetched[0];
+			m_prefetched.RemoveAt(0);
+			process_message(next);
+			continue;
+		}
+
+		// Fill all free slots plus the prefetch buffer with one call
+		const unsigned int free_slots = m_max_in_flight - m_in_flight.Num();
+		const unsigned int max_messages = FMath::Min(free_slots + m_long_poll_max_msg - 1, s_max_batch_size);
+
+		// Messages that wait in the buffer have to be kept invisible, for which I need to know
+		// how long the queue hides them
+		if ((max_messages > 1 || m_visibility_heartbeat) && m_visibility_timeout == 0)
+		{
+			read_visibility_timeout();
+		}
+
 		ReceiveMessageRequest rm_req;
 		rm_req.SetQueueUrl(m_queue_url);
-		rm_req.SetMaxNumberOfMessages(1);
+		rm_req.SetMaxNumberOfMessages(max_messages);
 
 		// This is not a timeout per se but long polling, which means the call will return
 		// After this many seconds even if there are no messages, which is not an error.
 		// See https://docs.aws.amazon.com/AWSSimpleQueueService/latest/SQSDeveloperGuide/sqs-short-and-long-polling.html#sqs-long-polling
-		rm_req.SetWaitTimeSeconds(m_long_poll_wait_time);
+		// While messages are in flight I have to come back quickly to acknowledge them
+		const unsigned int wait_time = m_in_flight.IsEmpty() ? m_long_poll_wait_time : 1;
+		rm_req.SetWaitTimeSeconds(wait_time);
 
 		// In order to enable us to support a number of polling strategies,
 		// I request some additional info with each message
@@ -153,23 +230,232 @@ void USQSImpl::long_poll() noexcept
 		{
 			// no messages in Q
 			UE_LOG(LogMVAWS, Display, TEXT("Long polling returned from queue '%s' with a timeout of %is, no messages"), 
-					UTF8_TO_TCHAR(m_queue_url.c_str()), m_long_poll_wait_time);
+					UTF8_TO_TCHAR(m_queue_url.c_str()), wait_time);
 			continue;
 		}
 
 		UE_LOG(LogMVAWS, Display, TEXT("Long polling with a timeout of %is returned from queue '%s', %i messages"),
-				m_long_poll_wait_time, UTF8_TO_TCHAR(m_queue_url.c_str()), rm_out.GetResult().GetMessages().size());
+				wait_time, UTF8_TO_TCHAR(m_queue_url.c_str()), rm_out.GetResult().GetMessages().size());
 
 		// Now get the messages and copy into our local storage.
-		// They will accumulate until the consumer retrieves them
-		process_message(rm_out.GetResult().GetMessages()[0]);
+		// The next iterations hand them out as long as there are free slots
+		const double received = FPlatformTime::Seconds();
+		for (const Message &message : rm_out.GetResult().GetMessages())
+		{
+			m_prefetched.Add(FSQSPrefetchedMessage{ message, received + m_visibility_timeout, received });
+		}
+	}
+
+	release_prefetched();
+
+	// Messages still with the delegate are waited for, so they can be acknowledged
+	while (!m_in_flight.IsEmpty())
+	{
+		wait_for_in_flight();
+	}
+}
+
+void USQSImpl::reap_in_flight() noexcept
+{
+	for (int32 i = 0; i < m_in_flight.Num(); )
+	{
+		const int8 result = m_in_flight[i].m_result->Load();
+		if (result < 0)
+		{
+			++i;
+			continue;
+		}
+
+		if (result) {
+			delete_message(m_in_flight[i].m_message);
+		} else {
+			UE_LOG(LogMVAWS, Display, TEXT("Not deleting message '%s', handler returned false"),
+				UTF8_TO_TCHAR(m_in_flight[i].m_message.GetMessageId().c_str()));
+		}
+
+		m_in_flight.RemoveAt(i);
+	}
+}
+
+void USQSImpl::wait_for_in_flight() noexcept
+{
+	// This might take forever if the implementation is not careful.
+	// It might be worthwhile to include a timeout but I want to discuss this first.
+	// Meanwhile, prefetched and in flight messages must not become visible to others again.
+	while (!m_promise_set->m_event->Wait(FTimespan::FromSeconds(1)))
+	{
+		extend_visibility(m_visibility_timeout / 3.0);
+	}
+
+	reap_in_flight();
+}
+
+void USQSImpl::read_visibility_timeout() noexcept
+{
+	GetQueueAttributesRequest request;
+	request.SetQueueUrl(m_queue_url);
+	request.AddAttributeNames(QueueAttributeName::VisibilityTimeout);
+
+	const GetQueueAttributesOutcome outcome = m_sqs->GetQueueAttributes(request);
+	if (outcome.IsSuccess())
+	{
+		const Aws::Map<QueueAttributeName, Aws::String> &attributes = outcome.GetResult().GetAttributes();
+		const Aws::Map<QueueAttributeName, Aws::String>::const_iterator i = attributes.find(QueueAttributeName::VisibilityTimeout);
+		if (i != attributes.cend())
+		{
+			m_visibility_timeout = FCString::Atoi(UTF8_TO_TCHAR(i->second.c_str()));
+		}
+	}
+	else
+	{
+		UE_LOG(LogMVAWS, Warning, TEXT("Could not read visibility timeout of queue '%s': '%s'"),
+			UTF8_TO_TCHAR(m_queue_url.c_str()), UTF8_TO_TCHAR(outcome.GetError().GetMessage().c_str()));
+	}
+
+	if (m_visibility_timeout <= 0)
+	{
+		m_visibility_timeout = s_default_visibility_timeout;
+	}
+
+	UE_LOG(LogMVAWS, Display, TEXT("Prefetching up to %u messages, keeping them invisible for %is at a time, heartbeat %s"),
+		m_long_poll_max_msg, m_visibility_timeout, m_visibility_heartbeat ? TEXT("on") : TEXT("off"));
+}
+
+void USQSImpl::extend_visibility(const double n_prefetched_min_remaining) noexcept
+{
+	apply_visibility_updates();
+
+	// Neither prefetching nor heartbeat, the queue's own visibility timeout applies
+	if (m_visibility_timeout == 0)
+	{
+		return;
+	}
+
+	struct due_message {
+		const Message *m_message;
+		double        *m_visible_until;
+	};
+
+	TArray<due_message> due;
+	const double now = FPlatformTime::Seconds();
+
+	for (FSQSPrefetchedMessage &prefetched : m_prefetched)
+	{
+		if (prefetched.m_visible_until - now < n_prefetched_min_remaining)
+		{
+			due.Add(due_message{ &prefetched.m_message, &prefetched.m_visible_until });
+		}
+	}
+
+	// Heartbeat for messages the delegate is working on. Once their promise
+	// is set they are no longer in m_in_flight and left alone
+	if (m_visibility_heartbeat)
+	{
+		for (FSQSInFlightMessage &in_flight : m_in_flight)
+		{
+			if (in_flight.m_visible_until - now < m_visibility_timeout / 3.0)
+			{
+				due.Add(due_message{ &in_flight.m_message, &in_flight.m_visible_until });
+			}
+		}
+	}
+
+	// Entry IDs are indices into due
+	for (int32 first = 0; first < due.Num(); first += s_max_batch_size)
+	{
+		const int32 last = FMath::Min(first + static_cast<int32>(s_max_batch_size), due.Num());
+
+		ChangeMessageVisibilityBatchRequest request;
+		request.SetQueueUrl(m_queue_url);
+
+		for (int32 i = first; i < last; ++i)
+		{
+			ChangeMessageVisibilityBatchRequestEntry entry;
+			entry.SetId(TCHAR_TO_UTF8(*FString::FromInt(i)));
+			entry.SetReceiptHandle(due[i].m_message->GetReceiptHandle());
+			entry.SetVisibilityTimeout(m_visibility_timeout);
+			request.AddEntries(MoveTemp(entry));
+		}
+
+		const ChangeMessageVisibilityBatchOutcome outcome = m_sqs->ChangeMessageVisibilityBatch(request);
+		if (!outcome.IsSuccess())
+		{
+			UE_LOG(LogMVAWS, Warning, TEXT("Failed to extend visibility of %i messages: '%s'"),
+				last - first, UTF8_TO_TCHAR(outcome.GetError().GetMessage().c_str()));
+			continue;
+		}
+
+		for (const ChangeMessageVisibilityBatchResultEntry &success : outcome.GetResult().GetSuccessful())
+		{
+			const int32 i = FCString::Atoi(UTF8_TO_TCHAR(success.GetId().c_str()));
+			if (i >= first && i < last)
+			{
+				*due[i].m_visible_until = now + m_visibility_timeout;
+				UE_LOG(LogMVAWS, Verbose, TEXT("Extended visibility of message '%s' by %is"),
+					UTF8_TO_TCHAR(due[i].m_message->GetMessageId().c_str()), m_visibility_timeout);
+			}
+		}
+
+		// Those will likely be received again by someone else. Nothing I can do about it
+		for (const BatchResultErrorEntry &failure : outcome.GetResult().GetFailed())
+		{
+			UE_LOG(LogMVAWS, Warning, TEXT("Failed to extend visibility of message: '%s'"),
+				UTF8_TO_TCHAR(failure.GetMessage().c_str()));
+		}
+	}
+}
+
+void USQSImpl::apply_visibility_updates() noexcept
+{
+	TPair<Aws::String, double> update;
+	while (m_visibility_updates.Dequeue(update))
+	{
+		for (FSQSInFlightMessage &in_flight : m_in_flight)
+		{
+			if (in_flight.m_message.GetMessageId() == update.Key)
+			{
+				in_flight.m_visible_until = update.Value;
+				break;
+			}
+		}
+	}
+}
 
-		continue;
+void USQSImpl::release_prefetched() noexcept
+{
+	if (m_prefetched.IsEmpty())
+	{
+		return;
 	}
+
+	UE_LOG(LogMVAWS, Display, TEXT("Releasing %i prefetched messages back into the queue"), m_prefetched.Num());
+
+	ChangeMessageVisibilityBatchRequest request;
+	request.SetQueueUrl(m_queue_url);
+
+	for (int32 i = 0; i < m_prefetched.Num(); ++i)
+	{
+		ChangeMessageVisibilityBatchRequestEntry entry;
+		entry.SetId(TCHAR_TO_UTF8(*FString::FromInt(i)));
+		entry.SetReceiptHandle(m_prefetched[i].m_message.GetReceiptHandle());
+		entry.SetVisibilityTimeout(0);
+		request.AddEntries(MoveTemp(entry));
+	}
+
+	const ChangeMessageVisibilityBatchOutcome outcome = m_sqs->ChangeMessageVisibilityBatch(request);
+	if (!outcome.IsSuccess())
+	{
+		UE_LOG(LogMVAWS, Warning, TEXT("Failed to release prefetched messages, they'll show up again after their visibility timeout: '%s'"),
+			UTF8_TO_TCHAR(outcome.GetError().GetMessage().c_str()));
+	}
+
+	m_prefetched.Empty();
 }
 
-void USQSImpl::process_message(const Message &n_message) const noexcept
+void USQSImpl::process_message(const FSQSPrefetchedMessage &n_prefetched) noexcept
 {
+	const Message &n_message = n_prefetched.m_message;
+
 	UE_LOG(LogMVAWS, Display, TEXT("process_message '%s'"), UTF8_TO_TCHAR(n_message.GetMessageId().c_str()));
 	
 	IMVAWSModule::Get().count_sqs_message();
@@ -218,18 +504,34 @@ void USQSImpl::process_message(const Message &n_message) const noexcept
 		trace_id = trace_id.Left(idx);
 	}
 
+	// Nobody traced this before, so this is where the trace starts
+	if (trace_id.IsEmpty())
+	{
+		trace_id = IMVAWSModule::Get().new_trace_id();
+	}
+
 	// Now construct a message which will be given into the handler
 	const FMVAWSMessage m{
 		UTF8_TO_TCHAR(n_message.GetMessageId().c_str()),
 		UTF8_TO_TCHAR(n_message.GetReceiptHandle().c_str()),
 		current_epoch_time - sent_epoch_time,
-		trace_id,                                  // @todo get and insert x-ray header
+		trace_id,
 		UTF8_TO_TCHAR(n_message.GetBody().c_str())
 	};
 
-	// This promise will be fulfilled by the delegate implementation
+	// This promise will be fulfilled by the delegate implementation.
+	// Whoever does that wakes up the poll thread, which then acknowledges the message
 	const SQSReturnPromisePtr rp = MakeShareable<SQSReturnPromise>(new SQSReturnPromise());
-	TFuture<bool> return_future = rp->GetFuture();
+	const TSharedRef<TAtomic<int8>, ESPMode::ThreadSafe> result = MakeShared<TAtomic<int8>, ESPMode::ThreadSafe>(-1);
+	rp->GetFuture().Then([result, signal{ m_promise_set }, received{ n_prefetched.m_received }, dispatched{ FPlatformTime::Seconds() }](TFuture<bool> n_result) {
+			result->Store(n_result.Get() ? 1 : 0);
+			signal->m_event->Trigger();
+
+			const double now = FPlatformTime::Seconds();
+			IMVAWSModule::Get().count_sqs_message_handled(static_cast<float>((now - dispatched) * 1000.0),
+					static_cast<float>((now - received) * 1000.0));
+		});
+	m_in_flight.Add(FSQSInFlightMessage{ n_message, result, n_prefetched.m_visible_until });
 
 	// Call the delegate on the game thread
 	if (m_handler_on_game_thread) {
@@ -242,37 +544,13 @@ void USQSImpl::process_message(const Message &n_message) const noexcept
 	} else {
 		m_delegate.Execute(m, rp);
 	}
-
-	// Now we wait for the delegate impl to call SetValue() on the promise.
-	// This might take forever if the implementation is not careful.
-	// It might be worthwhile to include a timeout but I want to discuss this first.
-	return_future.Wait();
-	if (return_future.Get()) {
-		delete_message(n_message);
-	} else {
-		UE_LOG(LogMVAWS, Display, TEXT("Not deleting message '%s', handler returned false"), *m.m_message_id);
-	}
 }
 
 void USQSImpl::delete_message(const Message &n_message) const noexcept
 {
-	UE_LOG(LogMVAWS, Verbose, TEXT("Starting deletion of message '%s'"), UTF8_TO_TCHAR(n_message.GetMessageId().c_str()));
-
-	DeleteMessageRequest request;
-	request.SetQueueUrl(m_queue_url);
-	request.SetReceiptHandle(n_message.GetReceiptHandle());
-
-	// issue the delete request
-	const DeleteMessageOutcome outcome = m_sqs->DeleteMessage(request);
+	UE_LOG(LogMVAWS, Verbose, TEXT("Queueing deletion of message '%s'"), UTF8_TO_TCHAR(n_message.GetMessageId().c_str()));
 
-	if (outcome.IsSuccess())
-	{
-		UE_LOG(LogMVAWS, Display, TEXT("Deleted message '%s'"), UTF8_TO_TCHAR(n_message.GetMessageId().c_str()));
-	}
-	else
-	{
-		UE_LOG(LogMVAWS, Error, TEXT("Deletion of message '%s' failed: %s"), UTF8_TO_TCHAR(n_message.GetMessageId().c_str()), UTF8_TO_TCHAR(outcome.GetError().GetMessage().c_str()));
-	}
+	m_deleter->enqueue(n_message.GetMessageId(), n_message.GetReceiptHandle());
 }
 
 
@@ -293,6 +571,10 @@ void USQSImpl::set_message_visibilty_timeout(const FMVAWSMessage& n_message, con
 	if (outcome.IsSuccess())
 	{
 		UE_LOG(LogMVAWS, Log, TEXT("Message visibility timeout extended by %i seconds"), changetimeout_req.GetVisibilityTimeout());
+
+		// Let the heartbeat know so it doesn't shorten this
+		m_visibility_updates.Enqueue(TPair<Aws::String, double>{ TCHAR_TO_UTF8(*n_message.m_message_id),
+				FPlatformTime::Seconds() + n_timeout });
 	}
 	else
 	{
@@ -7,22 +7,53 @@
 #include "CoreMinimal.h"
 #include "MVAWS.h"
 #include "HAL/Thread.h"
+#include "Containers/Queue.h"
+#include "SQSDeleteBatcher.h"
 
 #include "Windows/PreWindowsApi.h"
 #include <aws/core/Aws.h>
 #include <aws/core/utils/memory/stl/AWSString.h>
+#include <aws/sqs/model/Message.h>
 #include "Windows/PostWindowsApi.h"
 
 #include "SQSImpl.generated.h"
 
-namespace Aws::SQS::Model {
-	class Message;
-}
-
 namespace Aws::SQS {
 	class SQSClient;
 }
 
+/*!
+ * A message received ahead of time, waiting in the local buffer to be handed to the delegate.
+ * I track when it becomes visible to other consumers again so I can extend that in time.
+ */
+struct FSQSPrefetchedMessage {
+
+	Aws::SQS::Model::Message m_message;
+
+	/// FPlatformTime::Seconds() at which the message is visible in the queue again
+	double                   m_visible_until;
+
+	/// FPlatformTime::Seconds() when the message was received
+	double                   m_received;
+};
+
+/*!
+ * A message handed to the delegate whose promise is not yet set
+ */
+struct FSQSInFlightMessage {
+
+	Aws::SQS::Model::Message m_message;
+
+	/// -1 while the delegate is working on it, then 0 or 1 as the promise was set
+	TSharedRef<TAtomic<int8>, ESPMode::ThreadSafe> m_result;
+
+	/// FPlatformTime::Seconds() at which the message is visible in the queue again
+	double                   m_visible_until;
+};
+
+// wakes the poll thread when a promise is set, lives as long as the last promise
+struct FSQSPromiseSignal;
+
 /*!
 * Implementation wrapper for SQS functions.
 * This has no other function than bundle SQS related stuff in one place.
@@ -33,13 +64,21 @@ class USQSImpl : public UObject {
 	GENERATED_BODY()
 
 	public:
-		void set_parameters(const FString &n_queue_url, const unsigned int n_wait_time, const bool n_handle_on_game_thread);
+		/*!
+		 * @param n_prefetch_count how many messages to receive with each call (1-10).
+		 *        More than one are buffered locally and handed out one by one.
+		 * @param n_visibility_heartbeat keep messages the delegate works on invisible
+		 *        until their promise is set
+		 */
+		void set_parameters(const FString &n_queue_url, const unsigned int n_wait_time, const bool n_handle_on_game_thread,
+				const unsigned int n_prefetch_count = 1, const bool n_visibility_heartbeat = false);
 		
 		/*! I assume one queue for all our messages.
 		 * This also starts the listening process. If the string is empty,
 		 * the listening thread is stopped.
+		 * @param n_max_in_flight how many messages may be with the delegate at once
 		 */
-		bool start_polling(FOnSQSMessageReceived &&n_delegate);
+		bool start_polling(FOnSQSMessageReceived &&n_delegate, const int n_max_in_flight = 1);
 
 		//! stop the polling thread. Non-blocking. Call join() afterwards to wait for it to complete
 		void stop_polling() noexcept;
@@ -49,6 +88,7 @@ class USQSImpl : public UObject {
 		*	Sets the new visibility timeout value in seconds for the message being in the queue
 		*	The message should not visible to other customers, for the delete message request to 
 		*	be successful. Can be called from any thread.
+		*	With the heartbeat on, it will take over from the new timeout.
 		*/
 		void set_message_visibilty_timeout(const FMVAWSMessage& n_message,const int n_timeout) const noexcept;
 
@@ -56,17 +96,58 @@ class USQSImpl : public UObject {
 		// running in thread
 		void long_poll() noexcept;
 
-		// copy messages out of a received bunch into our local storage
-		void process_message(const Aws::SQS::Model::Message &n_message) const noexcept;
+		// hand a message to the delegate and remember it as in flight. Doesn't wait for the result
+		void process_message(const FSQSPrefetchedMessage &n_message) noexcept;
+
+		// delete (or not) messages whose promises were set and free their slots
+		void reap_in_flight() noexcept;
+
+		// block until a promise was set, keeping prefetched messages invisible meanwhile
+		void wait_for_in_flight() noexcept;
+
+		// ask the queue for its visibility timeout, which prefetched messages are received with
+		void read_visibility_timeout() noexcept;
+
+		/*!
+		 * Extend visibility of all prefetched messages which have less than n_prefetched_min_remaining
+		 * seconds of it left back to the queue's visibility timeout.
+		 * With the heartbeat on, the same goes for in flight messages with less than a third left.
+		 * Batch calls of up to 10.
+		 */
+		void extend_visibility(const double n_prefetched_min_remaining) noexcept;
 
+		// take over visibility timeouts set by set_message_visibilty_timeout()
+		void apply_visibility_updates() noexcept;
+
+		// make all prefetched messages visible again so other consumers can have them
+		void release_prefetched() noexcept;
+
+		// queue the message for deletion in the next batch
 		void delete_message(const Aws::SQS::Model::Message &n_message) const noexcept;
 
-		TSharedPtr<Aws::SQS::SQSClient>   m_sqs;
+		TSharedPtr<Aws::SQS::SQSClient, ESPMode::ThreadSafe> m_sqs;
+		TUniquePtr<FSQSDeleteBatcher> m_deleter;
 		Aws::String           m_queue_url;
-		unsigned int          m_long_poll_max_msg;
+		unsigned int          m_long_poll_max_msg = 1;
 		unsigned int          m_long_poll_wait_time;
 		bool                  m_handler_on_game_thread;
 
+		bool                  m_visibility_heartbeat = false;
+
+		// visibility timeout of the queue in seconds, 0 if not yet known
+		int                   m_visibility_timeout = 0;
+
+		// message ID and new FPlatformTime::Seconds() of visibility, from any thread to the poll thread
+		mutable TQueue<TPair<Aws::String, double>, EQueueMode::Mpsc> m_visibility_updates;
+
+		// only touched by the poll thread
+		TArray<FSQSPrefetchedMessage> m_prefetched;
+		TArray<FSQSInFlightMessage>   m_in_flight;
+		unsigned int                  m_max_in_flight = 1;
+
+		// triggered whenever a delegate sets a promise
+		TSharedPtr<FSQSPromiseSignal, ESPMode::ThreadSafe> m_promise_set;
+
 		TUniquePtr<FThread>   m_poll_thread;
 		TAtomic<bool>         m_poll_interrupted;
 
@@ -7,8 +7,22 @@
 #include "Interfaces/IHttpRequest.h"
 #include "Interfaces/IHttpResponse.h"
 #include "HTTP/Public/HttpModule.h"
+#include "Misc/SecureHash.h"
 
 #include <cstdlib>
+#include <cstring>
+
+FString md5_utf8(const FString &n_text)
+{
+	const FTCHARToUTF8 utf8{ *n_text };
+
+	FMD5 md5;
+	md5.Update(reinterpret_cast<const uint8 *>(utf8.Get()), static_cast<uint64>(utf8.Length()));
+
+	uint8 digest[16];
+	md5.Final(digest);
+	return BytesToHex(digest, sizeof(digest)).ToLower();
+}
 
 FString readenv(const FString &n_env_variable_name, const FString &n_default) {
 
@@ -46,6 +60,11 @@ bool use_endpoint_discovery() {
 	return true_or_false_env(TEXT("MVAWS_ENABLE_ENDPOINT_DISCOVERY"));
 }
 
+bool s3_use_path_style() {
+
+	return true_or_false_env(TEXT("MVAWS_S3_PATH_STYLE"));
+}
+
 bool cloudwatch_metrics_enabled(const bool n_default) {
 
 	return true_or_false_env(TEXT("MVAWS_CLOUDWATCH_METRICS"), n_default);
@@ -103,3 +122,68 @@ FString get_instance_id()
 
 	return instance_id;
 }
+
+int32 utf16_to_utf8(const TCHAR *n_source, const int32 n_length, char *n_dest) noexcept {
+
+	static_assert(sizeof(TCHAR) == 2, "TCHAR is expected to be UTF-16");
+
+	char *out = n_dest;
+	int32 i = 0;
+
+	while (i < n_length) {
+
+		// Four characters at a time while they are all ASCII
+		while (i + 4 <= n_length) {
+			uint64 chunk;
+			std::memcpy(&chunk, n_source + i, sizeof(chunk));
+			if (chunk & 0xFF80FF80FF80FF80ull) {
+				break;
+			}
+
+			out[0] = static_cast<char>(n_source[i]);
+			out[1] = static_cast<char>(n_source[i + 1]);
+			out[2] = static_cast<char>(n_source[i + 2]);
+			out[3] = static_cast<char>(n_source[i + 3]);
+			out += 4;
+			i += 4;
+		}
+
+		if (i >= n_length) {
+			break;
+		}
+
+		uint32 c = static_cast<uint16>(n_source[i++]);
+
+		if (c < 0x80) {
+			*out++ = static_cast<char>(c);
+			continue;
+		}
+
+		if (c < 0x800) {
+			*out++ = static_cast<char>(0xC0 | (c >> 6));
+			*out++ = static_cast<char>(0x80 | (c & 0x3F));
+			continue;
+		}
+
+		if (c >= 0xD800 && c <= 0xDFFF) {
+			const uint32 low = (i < n_length) ? static_cast<uint16>(n_source[i]) : 0;
+			if (c <= 0xDBFF && low >= 0xDC00 && low <= 0xDFFF) {
+				++i;
+				c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+				*out++ = static_cast<char>(0xF0 | (c >> 18));
+				*out++ = static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+				*out++ = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+				*out++ = static_cast<char>(0x80 | (c & 0x3F));
+				continue;
+			}
+
+			c = 0xFFFD;
+		}
+
+		*out++ = static_cast<char>(0xE0 | (c >> 12));
+		*out++ = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+		*out++ = static_cast<char>(0x80 | (c & 0x3F));
+	}
+
+	return static_cast<int32>(out - n_dest);
+}
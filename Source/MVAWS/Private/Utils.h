@@ -20,6 +20,20 @@ inline double epoch_millis() {
 		std::chrono::system_clock::now().time_since_epoch()).count() / 1000.0;
 }
 
+/**
+ * @brief Convert UTF-16 text to UTF-8. Runs of ASCII, which logs mostly are, are
+ * converted several characters at a time. Unpaired surrogates become U+FFFD.
+ * @param n_dest must have room for 3 * n_length bytes
+ * @return number of bytes written
+ */
+int32 utf16_to_utf8(const TCHAR *n_source, const int32 n_length, char *n_dest) noexcept;
+
+/**
+ * @brief MD5 of the text's UTF-8 bytes as lowercase hex, for file names derived from
+ * keys and paths. Unlike FMD5::HashAnsiString, non-ANSI characters count.
+ */
+FString md5_utf8(const FString &n_text);
+
 /**
  * @brief read env by using _dupenv_s
  * @param n_env_variable_name read this environment variable
@@ -33,6 +47,14 @@ FString readenv(const FString &n_env_variable_name, const FString &n_default = F
  */
 bool use_endpoint_discovery();
 
+/**
+ * @brief Read env variable MVAWS_S3_PATH_STYLE to determine if S3 requests should address
+ * buckets in the path rather than the host name. Needed for most local S3 stand-ins
+ * given in MVAWS_S3_ENDPOINT.
+ * @return defaults to false, true if env set to True
+ */
+bool s3_use_path_style();
+
 /**
  * @brief Read env variable MVAWS_CLOUDWATCH_METRICS to determine if we should activate CloudWatch metrics
  * @return defaults to n_default, true if env set to True
@@ -0,0 +1,143 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#include "XRayDaemonEmitter.h"
+#include "IMVAWS.h"
+#include "Utils.h"
+
+// Engine
+#include "Sockets.h"
+#include "SocketSubsystem.h"
+
+#include <cstring>
+
+namespace
+{
+
+/// Every datagram starts with this line
+constexpr char s_header[] = "{\"format\": \"json\", \"version\": 1}\n";
+constexpr int32 s_header_bytes = sizeof(s_header) - 1;
+
+constexpr int32 s_default_port = 2000;
+
+/*!
+ * AWS_XRAY_DAEMON_ADDRESS is either "host:port" or, when the daemon listens on
+ * different addresses for UDP and TCP, "tcp:host:port udp:host:port".
+ * I only care about UDP.
+ */
+void parse_daemon_address(const FString &n_address, FString &n_host, int32 &n_port)
+{
+	n_host = TEXT("127.0.0.1");
+	n_port = s_default_port;
+
+	FString address = n_address.TrimStartAndEnd();
+	if (address.IsEmpty())
+	{
+		return;
+	}
+
+	TArray<FString> parts;
+	address.ParseIntoArrayWS(parts);
+	for (const FString &part : parts)
+	{
+		if (part.StartsWith(TEXT("udp:")))
+		{
+			address = part.RightChop(4);
+			break;
+		}
+
+		if (!part.StartsWith(TEXT("tcp:")))
+		{
+			address = part;
+		}
+	}
+
+	FString port;
+	if (address.Split(TEXT(":"), &n_host, &port, ESearchCase::CaseSensitive, ESearchDir::FromEnd))
+	{
+		n_port = FCString::Atoi(*port);
+	}
+	else
+	{
+		n_host = address;
+	}
+}
+
+} // anon ns
+
+FXRayDaemonEmitter::FXRayDaemonEmitter()
+{
+	ISocketSubsystem *sockets = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+	if (!sockets)
+	{
+		UE_LOG(LogMVAWS, Error, TEXT("No socket subsystem, cannot send to X-Ray daemon"));
+		return;
+	}
+
+	FString host;
+	int32 port = 0;
+	parse_daemon_address(readenv(TEXT("AWS_XRAY_DAEMON_ADDRESS")), host, port);
+
+	// Resolved once. Host names are fine too
+	const FAddressInfoResult resolved = sockets->GetAddressInfo(*host, nullptr,
+			EAddressInfoFlags::Default, NAME_None, ESocketType::SOCKTYPE_Datagram);
+	if (resolved.ReturnCode != SE_NO_ERROR || resolved.Results.Num() == 0)
+	{
+		UE_LOG(LogMVAWS, Error, TEXT("Cannot resolve X-Ray daemon address '%s'"), *host);
+		return;
+	}
+
+	m_daemon = resolved.Results[0].Address->Clone();
+	m_daemon->SetPort(port);
+
+	m_socket = sockets->CreateSocket(NAME_DGram, TEXT("MVAWS X-Ray daemon"), m_daemon->GetProtocolType());
+	if (!m_socket)
+	{
+		UE_LOG(LogMVAWS, Error, TEXT("Cannot create socket to send to X-Ray daemon"));
+		m_daemon.Reset();
+		return;
+	}
+
+	m_socket->SetNonBlocking(true);
+	UE_LOG(LogMVAWS, Display, TEXT("Sending X-Ray segments to daemon at %s"), *m_daemon->ToString(true));
+}
+
+FXRayDaemonEmitter::~FXRayDaemonEmitter() noexcept
+{
+	if (m_socket)
+	{
+		m_socket->Close();
+		ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(m_socket);
+		m_socket = nullptr;
+	}
+}
+
+bool FXRayDaemonEmitter::is_valid() const noexcept
+{
+	return m_socket && m_daemon;
+}
+
+int32 FXRayDaemonEmitter::max_document_bytes() noexcept
+{
+	return s_max_datagram_bytes - s_header_bytes;
+}
+
+bool FXRayDaemonEmitter::send(const Aws::String &n_document) const noexcept
+{
+	if (!is_valid() || n_document.size() > static_cast<size_t>(max_document_bytes()))
+	{
+		return false;
+	}
+
+	// Header and document have to go out in one datagram.
+	// Assembled in a buffer per thread as the caller's stack may be small
+	thread_local TArray<uint8> datagram;
+	const int32 size = s_header_bytes + static_cast<int32>(n_document.size());
+	datagram.SetNumUninitialized(size, false);
+	std::memcpy(datagram.GetData(), s_header, s_header_bytes);
+	std::memcpy(datagram.GetData() + s_header_bytes, n_document.data(), n_document.size());
+
+	int32 sent = 0;
+	return m_socket->SendTo(datagram.GetData(), size, sent, *m_daemon) && sent == size;
+}
@@ -0,0 +1,51 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#pragma once
+
+#include "CoreMinimal.h"
+#include "IPAddress.h"
+
+#include "Windows/PreWindowsApi.h"
+#include <aws/core/Aws.h>
+#include <aws/core/utils/memory/stl/AWSString.h>
+#include "Windows/PostWindowsApi.h"
+
+class FSocket;
+
+/*!
+ * Sends X-Ray segment documents as UDP datagrams to a local X-Ray daemon,
+ * which takes care of batching and sending them on to X-Ray.
+ * The daemon is found at AWS_XRAY_DAEMON_ADDRESS, or 127.0.0.1:2000 if that isn't set.
+ * Sending is a single non-blocking call, there is no acknowledgement.
+ */
+class FXRayDaemonEmitter
+{
+	public:
+		/// Largest UDP payload over IPv4, including the header line. The daemon takes up to 64 KB
+		/// but larger datagrams than this can't be sent at all
+		static constexpr int32 s_max_datagram_bytes = 65507;
+
+		FXRayDaemonEmitter();
+		~FXRayDaemonEmitter() noexcept;
+
+		FXRayDaemonEmitter(const FXRayDaemonEmitter &) = delete;
+		FXRayDaemonEmitter &operator=(const FXRayDaemonEmitter &) = delete;
+
+		/// false if the address could not be resolved or the socket not be created
+		bool is_valid() const noexcept;
+
+		/// Largest document that fits into a datagram
+		static int32 max_document_bytes() noexcept;
+
+		/*!
+		 * Send one segment or subsegment document. Thread safe.
+		 * \return false if it is too large or the socket refused it
+		 */
+		bool send(const Aws::String &n_document) const noexcept;
+
+	private:
+		FSocket                   *m_socket = nullptr;
+		TSharedPtr<FInternetAddr>  m_daemon;
+};
@@ -0,0 +1,91 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#include "XRayIds.h"
+#include "Utils.h"
+
+// Std
+#include <random>
+
+namespace {
+
+// xoshiro256** by Blackman and Vigna, see https://prng.di.unimi.it/
+class xoshiro256
+{
+	public:
+		xoshiro256() noexcept
+		{
+			// The OS is asked once per thread. splitmix64 spreads that over the
+			// whole state, which must not be all zero
+			std::random_device rd;
+			uint64 seed = (static_cast<uint64>(rd()) << 32) ^ rd();
+			for (uint64 &s : m_state) {
+				s = splitmix64(seed);
+			}
+		}
+
+		uint64 next() noexcept
+		{
+			const uint64 result = rotl(m_state[1] * 5, 7) * 9;
+			const uint64 t = m_state[1] << 17;
+
+			m_state[2] ^= m_state[0];
+			m_state[3] ^= m_state[1];
+			m_state[1] ^= m_state[2];
+			m_state[0] ^= m_state[3];
+
+			m_state[2] ^= t;
+			m_state[3] = rotl(m_state[3], 45);
+
+			return result;
+		}
+
+	private:
+		static uint64 rotl(const uint64 n_x, const int n_k) noexcept
+		{
+			return (n_x << n_k) | (n_x >> (64 - n_k));
+		}
+
+		static uint64 splitmix64(uint64 &n_x) noexcept
+		{
+			uint64 z = (n_x += 0x9e3779b97f4a7c15ull);
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+			return z ^ (z >> 31);
+		}
+
+		uint64 m_state[4];
+};
+
+xoshiro256 &generator() noexcept
+{
+	static thread_local xoshiro256 s_generator;
+	return s_generator;
+}
+
+}
+
+uint64 xray_random_id() noexcept
+{
+	uint64 id;
+	do {
+		id = generator().next();
+	} while (id == 0);
+
+	return id;
+}
+
+FString xray_format_id(const uint64 n_id)
+{
+	return FString::Printf(TEXT("%016llx"), n_id);
+}
+
+FString xray_new_trace_id()
+{
+	const uint32 epoch_seconds = static_cast<uint32>(epoch_milliseconds() / 1000);
+	const uint64 high = generator().next();
+	const uint32 low = static_cast<uint32>(generator().next());
+
+	return FString::Printf(TEXT("1-%08x-%016llx%08x"), epoch_seconds, high, low);
+}
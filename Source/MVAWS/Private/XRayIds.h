@@ -0,0 +1,25 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#pragma once
+
+#include "CoreMinimal.h"
+
+/*!
+ * Random 64 bit number, never 0. Drawn from a xoshiro256** generator each thread
+ * has for itself, seeded once from the OS when the thread first needs an id.
+ * No locks, no syscalls after that.
+ */
+uint64 xray_random_id() noexcept;
+
+/*!
+ * id for a segment or subsegment: 16 lower case hex digits
+ */
+FString xray_format_id(const uint64 n_id);
+
+/*!
+ * a new root trace id, as in "1-5759e988-bd862e3fe1be46a994272793".
+ * Version 1, epoch seconds as 8 hex digits and 96 random bits as 24 hex digits.
+ */
+FString xray_new_trace_id();
@@ -6,18 +6,12 @@
 
 #include "CoreMinimal.h"
 #include "HAL/Thread.h"
-#include "Dom/JsonObject.h"
+#include "XRaySender.h"
+#include "XRayDaemonEmitter.h"
+#include "XRayTraceStore.h"
 
 #include "XRayImpl.generated.h"
 
-namespace Aws 
-{
-	namespace XRay
-	{
-		class XRayClient;
-	}
-}
-
 /*!
  * Implementation for XRay tracing functions
  */
@@ -30,6 +24,22 @@ class UXRayImpl : public UObject
 	public:
 		void BeginDestroy() override;
 
+		/*!
+		 * create the client and start the thread sending finished segments
+		 * \param n_use_daemon send to a local X-Ray daemon via UDP instead
+		 */
+		void start(const bool n_use_daemon);
+
+		//! send what's queued and stop. Blocking
+		void shutdown() noexcept;
+
+		/*!
+		* a new root trace id, for work that didn't come with one
+		* \return trace identifier to start segments with
+		*/
+		UFUNCTION(BlueprintCallable, Category = "XRayImpl")
+		FString new_trace_id() const;
+
 		/*!
 		* start tracing a segment
 		* \param n_trace_id 
@@ -65,33 +75,24 @@ class UXRayImpl : public UObject
 		void end_trace_segment(const FString &n_trace_id, const bool n_error);
 
 	private:
-		using DocumentPtr = TSharedPtr<FJsonObject>;
-		/*!
-		* a map of currently active segments by trace ID
-		*/
-		using DocumentMap = TMap<FString, DocumentPtr>; 
+		//! hand a serialized document to the daemon or the sender
+		void deliver(const uint64 n_segment_id, const Aws::String &n_document) const noexcept;
 
-		using SubSegmentArray = TArray<DocumentPtr>;
+		//! largest document X-Ray takes. Larger segments are sent as separate subsegments
+		int32 max_document_bytes() const noexcept;
 
 		/*!
-		* a map of subsegments to be sent ref'ed by trace ID
+		* Sends finished segments in the background. Set as long as X-Ray is enabled
 		*/
-		using SubSegmentMap = TMap<FString, SubSegmentArray>;
+		TUniquePtr<FXRaySender> m_sender;
 
 		/*!
-		* This is pooled with a thread executor so we can re-use it everywhere
+		* Or this one if we're sending to a daemon
 		*/
-		Aws::XRay::XRayClient  *m_xray;
+		TUniquePtr<FXRayDaemonEmitter> m_emitter;
 
 		/*!
-		* complete documents we have in flight
+		* segments in progress and their subsegments
 		*/
-		DocumentMap             m_segments;
-
-		/*!
-		* and their subsegments
-		*/
-		SubSegmentMap           m_subsegments;
-
-		static FCriticalSection s_mutex;       //Those have to be static in Unreal. Why?
+		TUniquePtr<FXRayTraceStore> m_store = MakeUnique<FXRayTraceStore>();
 };
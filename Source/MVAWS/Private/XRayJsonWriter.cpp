@@ -0,0 +1,167 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#include "XRayJsonWriter.h"
+#include "Utils.h"
+
+// Std
+#include <cstdio>
+
+const Aws::String &FXRayJsonWriter::segment(const FXRaySegment &n_segment, const bool n_subsegments)
+{
+	m_buffer.clear();
+	m_buffer += '{';
+	m_first = true;
+
+	field("name", n_segment.m_name);
+	field("trace_id", n_segment.m_trace_id);
+	field("origin", "AWS::EC2::Instance");
+	id_field("id", n_segment.m_id);
+	time_field("start_time", n_segment.m_start_time);
+	time_field("end_time", n_segment.m_end_time);
+	bool_field("in_progress", false);
+
+	if (n_segment.m_fault) {
+		bool_field("fault", true);
+	}
+
+	if (n_subsegments && n_segment.m_subsegments.Num()) {
+		key("subsegments");
+		m_buffer += '[';
+		for (int32 i = 0; i < n_segment.m_subsegments.Num(); ++i) {
+			if (i) {
+				m_buffer += ',';
+			}
+			m_buffer += '{';
+			m_first = true;
+			subsegment_fields(n_segment.m_subsegments[i]);
+			m_buffer += '}';
+		}
+		m_buffer += ']';
+	}
+
+	m_buffer += '}';
+	return m_buffer;
+}
+
+const Aws::String &FXRayJsonWriter::subsegment(const FXRaySegment &n_parent, const FXRaySubsegment &n_subsegment)
+{
+	m_buffer.clear();
+	m_buffer += '{';
+	m_first = true;
+
+	subsegment_fields(n_subsegment);
+	field("type", "subsegment");
+	field("trace_id", n_parent.m_trace_id);
+	id_field("parent_id", n_parent.m_id);
+
+	m_buffer += '}';
+	return m_buffer;
+}
+
+void FXRayJsonWriter::subsegment_fields(const FXRaySubsegment &n_subsegment)
+{
+	time_field("start_time", n_subsegment.m_start_time);
+	field("name", n_subsegment.m_name);
+	field("namespace", "remote");
+	id_field("id", n_subsegment.m_id);
+
+	if (n_subsegment.m_end_time > 0.0) {
+		bool_field("in_progress", false);
+		time_field("end_time", n_subsegment.m_end_time);
+	} else {
+		bool_field("in_progress", true);
+	}
+
+	if (n_subsegment.m_fault) {
+		bool_field("fault", true);
+	}
+}
+
+void FXRayJsonWriter::key(const char *n_key)
+{
+	if (!m_first) {
+		m_buffer += ',';
+	}
+	m_first = false;
+
+	m_buffer += '"';
+	m_buffer += n_key;
+	m_buffer += "\":";
+}
+
+void FXRayJsonWriter::field(const char *n_key, const FString &n_value)
+{
+	key(n_key);
+	string(n_value);
+}
+
+void FXRayJsonWriter::field(const char *n_key, const char *n_value)
+{
+	// Only called with literals that need no escaping
+	key(n_key);
+	m_buffer += '"';
+	m_buffer += n_value;
+	m_buffer += '"';
+}
+
+void FXRayJsonWriter::id_field(const char *n_key, const uint64 n_id)
+{
+	char id[17];
+	std::snprintf(id, sizeof(id), "%016llx", static_cast<unsigned long long>(n_id));
+	field(n_key, id);
+}
+
+void FXRayJsonWriter::time_field(const char *n_key, const double n_seconds)
+{
+	// Epoch seconds with milliseconds is all the precision we have
+	char number[32];
+	const int length = std::snprintf(number, sizeof(number), "%.3f", n_seconds);
+
+	key(n_key);
+	m_buffer.append(number, length);
+}
+
+void FXRayJsonWriter::bool_field(const char *n_key, const bool n_value)
+{
+	key(n_key);
+	m_buffer += n_value ? "true" : "false";
+}
+
+void FXRayJsonWriter::string(const FString &n_value)
+{
+	m_utf8.SetNumUninitialized(n_value.Len() * 3, false);
+	const int32 length = utf16_to_utf8(*n_value, n_value.Len(), m_utf8.GetData());
+
+	static const char s_hex[] = "0123456789abcdef";
+
+	m_buffer += '"';
+	const char *text = m_utf8.GetData();
+	int32 start = 0;
+	for (int32 i = 0; i < length; ++i) {
+		const unsigned char c = static_cast<unsigned char>(text[i]);
+
+		// Bytes of multi byte UTF-8 sequences are all >= 0x80 and go in as they are
+		if (c >= 0x20 && c != '"' && c != '\\') {
+			continue;
+		}
+
+		m_buffer.append(text + start, i - start);
+		start = i + 1;
+
+		switch (c) {
+			case '"':  m_buffer += "\\\""; break;
+			case '\\': m_buffer += "\\\\"; break;
+			case '\n': m_buffer += "\\n"; break;
+			case '\r': m_buffer += "\\r"; break;
+			case '\t': m_buffer += "\\t"; break;
+			default: {
+				const char escaped[] = { '\\', 'u', '0', '0', s_hex[c >> 4], s_hex[c & 0xf] };
+				m_buffer.append(escaped, sizeof(escaped));
+			}
+		}
+	}
+	m_buffer.append(text + start, length - start);
+	m_buffer += '"';
+}
@@ -0,0 +1,57 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#pragma once
+
+#include "CoreMinimal.h"
+#include "XRayTraceStore.h"
+
+#include "Windows/PreWindowsApi.h"
+#include <aws/core/Aws.h>
+#include <aws/core/utils/memory/stl/AWSString.h>
+#include "Windows/PostWindowsApi.h"
+
+/*!
+ * Writes X-Ray segment documents as UTF-8 JSON, straight from the structs.
+ * The buffer is kept between documents, so once it has grown to the usual
+ * document size writing one doesn't allocate.
+ * See https://docs.aws.amazon.com/xray/latest/devguide/xray-api-segmentdocuments.html
+ * Not thread safe, use one per thread.
+ */
+class FXRayJsonWriter
+{
+	public:
+		/*!
+		 * the segment as a document
+		 * \param n_subsegments include the subsegments. Leave them out when they're sent on their own
+		 * \return the document, valid until the next call
+		 */
+		const Aws::String &segment(const FXRaySegment &n_segment, const bool n_subsegments);
+
+		/*!
+		 * a subsegment as a document of its own, referring to its parent segment
+		 * \return the document, valid until the next call
+		 */
+		const Aws::String &subsegment(const FXRaySegment &n_parent, const FXRaySubsegment &n_subsegment);
+
+	private:
+		// the fields of a subsegment, without braces
+		void subsegment_fields(const FXRaySubsegment &n_subsegment);
+
+		// a key, preceded by a comma unless it's the first in the object
+		void key(const char *n_key);
+
+		void field(const char *n_key, const FString &n_value);
+		void field(const char *n_key, const char *n_value);
+		void id_field(const char *n_key, const uint64 n_id);
+		void time_field(const char *n_key, const double n_seconds);
+		void bool_field(const char *n_key, const bool n_value);
+
+		// a JSON string, quoted and escaped
+		void string(const FString &n_value);
+
+		Aws::String      m_buffer;
+		TArray<char>     m_utf8;       // text before escaping, also reused
+		bool             m_first = true;
+};
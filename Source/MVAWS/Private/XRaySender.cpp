@@ -0,0 +1,189 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#include "XRaySender.h"
+#include "IMVAWS.h"
+#include "Utils.h"
+
+// Engine
+#include "HAL/Event.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+
+// AWS SDK
+#include "Windows/PreWindowsApi.h"
+#include <aws/core/client/ClientConfiguration.h>
+#include <aws/core/utils/memory/AWSMemory.h>
+#include <aws/core/utils/threading/Executor.h>
+#include <aws/xray/XRayClient.h>
+#include <aws/xray/model/PutTraceSegmentsRequest.h>
+#include <aws/xray/model/PutTraceSegmentsResult.h>
+#include "Windows/PostWindowsApi.h"
+
+using namespace Aws::XRay::Model;
+
+namespace
+{
+
+/// PutTraceSegments takes no more than this many documents per call
+constexpr int32 s_max_batch_documents = 50;
+
+/// and I keep requests well below its payload limit
+constexpr uint64 s_max_batch_bytes = 512 * 1024;
+
+/// How long a document may wait for others to join its batch (seconds)
+constexpr double s_flush_interval = 1.0;
+
+/// Documents are sent at most this often, with this pause in between (seconds)
+constexpr int32 s_max_attempts = 3;
+constexpr double s_retry_delay = 2.0;
+
+} // anon ns
+
+FXRaySender::FXRaySender()
+{
+	Aws::Client::ClientConfiguration client_config;
+	client_config.enableEndpointDiscovery = use_endpoint_discovery();
+	const FString xray_endpoint = readenv(TEXT("MVAWS_XRAY_ENDPOINT"));
+	if (!xray_endpoint.IsEmpty()) {
+		client_config.endpointOverride = TCHAR_TO_UTF8(*xray_endpoint);
+	}
+	m_xray = Aws::New<Aws::XRay::XRayClient>("xray", client_config);
+
+	m_wake = FPlatformProcess::GetSynchEventFromPool(false);
+	m_thread = MakeUnique<FThread>(TEXT("AWS_XRay_Send"), [this] { this->send_thread(); });
+}
+
+FXRaySender::~FXRaySender() noexcept
+{
+	m_stop.Store(true);
+	m_wake->Trigger();
+	m_thread->Join();
+	m_thread.Reset();
+
+	FPlatformProcess::ReturnSynchEventToPool(m_wake);
+	m_wake = nullptr;
+
+	Aws::Delete(m_xray);
+	m_xray = nullptr;
+}
+
+void FXRaySender::enqueue(const Aws::String &n_segment_id, Aws::String &&n_document) noexcept
+{
+	m_queue.Enqueue(pending_document{ n_segment_id, MoveTemp(n_document), FPlatformTime::Seconds() });
+	m_wake->Trigger();
+}
+
+void FXRaySender::send_thread() noexcept
+{
+	TArray<pending_document> batch;
+	TArray<pending_document> retry;
+	uint64 batch_bytes = 0;
+
+	while (true)
+	{
+		// read before draining so nothing enqueued before the stop is left behind
+		const bool stopping = m_stop;
+		const double now = FPlatformTime::Seconds();
+
+		// Retries that are due go first
+		for (int32 i = 0; i < retry.Num() && batch.Num() < s_max_batch_documents; )
+		{
+			if (stopping || retry[i].m_queued <= now)
+			{
+				batch_bytes += retry[i].m_document.size();
+				batch.Add(MoveTemp(retry[i]));
+				retry.RemoveAt(i);
+			}
+			else
+			{
+				++i;
+			}
+		}
+
+		pending_document next;
+		while (batch.Num() < s_max_batch_documents && batch_bytes < s_max_batch_bytes && m_queue.Dequeue(next))
+		{
+			batch_bytes += next.m_document.size();
+			batch.Add(MoveTemp(next));
+		}
+
+		const double waited = batch.IsEmpty() ? 0.0 : now - batch[0].m_queued;
+		if (batch.Num() == s_max_batch_documents || batch_bytes >= s_max_batch_bytes
+				|| (!batch.IsEmpty() && (stopping || waited >= s_flush_interval)))
+		{
+			flush(batch, retry);
+			batch.Reset();
+			batch_bytes = 0;
+			continue;
+		}
+
+		if (stopping && batch.IsEmpty() && retry.IsEmpty())
+		{
+			break;
+		}
+
+		// Sleep until more come in or the oldest one is due
+		const double timeout = batch.IsEmpty() ? (retry.IsEmpty() ? 1.0 : s_retry_delay) : s_flush_interval - waited;
+		m_wake->Wait(FTimespan::FromSeconds(timeout));
+	}
+}
+
+void FXRaySender::flush(TArray<pending_document> &n_batch, TArray<pending_document> &n_retry) const noexcept
+{
+	// A single document larger than the limit still goes out on its own
+	PutTraceSegmentsRequest request;
+	for (const pending_document &document : n_batch)
+	{
+		request.AddTraceSegmentDocuments(document.m_document);
+	}
+
+	TArray<int32> failed;
+
+	const double start_time = FPlatformTime::Seconds();
+	const PutTraceSegmentsOutcome outcome = m_xray->PutTraceSegments(request);
+	IMVAWSModule::Get().count_xray_flush(static_cast<float>((FPlatformTime::Seconds() - start_time) * 1000.0));
+
+	if (outcome.IsSuccess())
+	{
+		for (const UnprocessedTraceSegment &unprocessed : outcome.GetResult().GetUnprocessedTraceSegments())
+		{
+			const int32 i = n_batch.IndexOfByPredicate([&unprocessed](const pending_document &n_document) {
+					return n_document.m_segment_id == unprocessed.GetId();
+				});
+
+			UE_LOG(LogMVAWS, Warning, TEXT("X-Ray segment '%s' unprocessed: %s"),
+				UTF8_TO_TCHAR(unprocessed.GetId().c_str()), UTF8_TO_TCHAR(unprocessed.GetMessage().c_str()));
+			if (i != INDEX_NONE)
+			{
+				failed.Add(i);
+			}
+		}
+	}
+	else
+	{
+		UE_LOG(LogMVAWS, Warning, TEXT("Failed to send %i X-Ray documents: %s"),
+			n_batch.Num(), UTF8_TO_TCHAR(outcome.GetError().GetMessage().c_str()));
+
+		for (int32 i = 0; i < n_batch.Num(); ++i)
+		{
+			failed.Add(i);
+		}
+	}
+
+	const double retry_at = FPlatformTime::Seconds() + s_retry_delay;
+	for (const int32 i : failed)
+	{
+		pending_document &document = n_batch[i];
+		if (++document.m_attempts < s_max_attempts)
+		{
+			document.m_queued = retry_at;
+			n_retry.Add(MoveTemp(document));
+		}
+		else
+		{
+			UE_LOG(LogMVAWS, Error, TEXT("Giving up on X-Ray segment '%s'"), UTF8_TO_TCHAR(document.m_segment_id.c_str()));
+		}
+	}
+}
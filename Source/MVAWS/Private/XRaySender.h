@@ -0,0 +1,64 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Thread.h"
+#include "Containers/Queue.h"
+
+#include "Windows/PreWindowsApi.h"
+#include <aws/core/Aws.h>
+#include <aws/core/utils/memory/stl/AWSString.h>
+#include "Windows/PostWindowsApi.h"
+
+namespace Aws::XRay {
+	class XRayClient;
+}
+
+/*!
+ * Ships X-Ray segment documents off the caller's thread.
+ * Documents are queued and a background thread sends them with PutTraceSegments,
+ * as many per call as the API takes, once a full batch is together or the oldest
+ * has waited for a second. Documents X-Ray reports as unprocessed, or all of them
+ * when the call fails, are sent again with a later batch a few times.
+ */
+class FXRaySender
+{
+	public:
+		FXRaySender();
+
+		/// Sends everything still queued (blocking) and stops the thread
+		~FXRaySender() noexcept;
+
+		FXRaySender(const FXRaySender &) = delete;
+		FXRaySender &operator=(const FXRaySender &) = delete;
+
+		/*!
+		 * Queue a finished segment document. Returns right away. Thread safe.
+		 * @param n_segment_id the document's id, to match unprocessed segments
+		 */
+		void enqueue(const Aws::String &n_segment_id, Aws::String &&n_document) noexcept;
+
+	private:
+		struct pending_document {
+			Aws::String m_segment_id;
+			Aws::String m_document;
+			double      m_queued;          //!< FPlatformTime::Seconds(), when it may be sent for retries
+			int32       m_attempts = 0;
+		};
+
+		void send_thread() noexcept;
+
+		// one PutTraceSegments call. Documents to be sent again are added to n_retry
+		void flush(TArray<pending_document> &n_batch, TArray<pending_document> &n_retry) const noexcept;
+
+		Aws::XRay::XRayClient           *m_xray = nullptr;
+
+		TQueue<pending_document, EQueueMode::Mpsc> m_queue;
+		FEvent                          *m_wake = nullptr;
+
+		TUniquePtr<FThread>              m_thread;
+		TAtomic<bool>                    m_stop{ false };
+};
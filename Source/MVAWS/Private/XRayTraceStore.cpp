@@ -0,0 +1,69 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#include "XRayTraceStore.h"
+
+#include "Misc/ScopeLock.h"
+
+FXRayTraceStore::shard &FXRayTraceStore::shard_for(const FString &n_trace_id)
+{
+	return m_shards[GetTypeHash(n_trace_id) % s_shard_count];
+}
+
+void FXRayTraceStore::add_segment(FXRaySegment &&n_segment)
+{
+	shard &s = shard_for(n_segment.m_trace_id);
+
+	FScopeLock lock(&s.m_lock);
+	const FString trace_id = n_segment.m_trace_id;
+	s.m_segments.Emplace(trace_id, MoveTemp(n_segment));
+}
+
+bool FXRayTraceStore::add_subsegment(const FString &n_trace_id, FXRaySubsegment &&n_subsegment)
+{
+	shard &s = shard_for(n_trace_id);
+
+	FScopeLock lock(&s.m_lock);
+	FXRaySegment *segment = s.m_segments.Find(n_trace_id);
+	if (!segment)
+	{
+		return false;
+	}
+
+	segment->m_subsegments.Add(MoveTemp(n_subsegment));
+	return true;
+}
+
+bool FXRayTraceStore::end_subsegment(const FString &n_trace_id, const uint64 n_subsegment_id, const double n_end_time, const bool n_fault)
+{
+	shard &s = shard_for(n_trace_id);
+
+	FScopeLock lock(&s.m_lock);
+	FXRaySegment *segment = s.m_segments.Find(n_trace_id);
+	if (!segment)
+	{
+		return false;
+	}
+
+	// There are few subsegments per segment, so scanning their IDs beats a map
+	FXRaySubsegment *subsegment = segment->m_subsegments.FindByPredicate([n_subsegment_id](const FXRaySubsegment &n_subsegment) {
+			return n_subsegment.m_id == n_subsegment_id;
+		});
+	if (!subsegment || subsegment->m_end_time > 0.0)
+	{
+		return false;
+	}
+
+	subsegment->m_end_time = n_end_time;
+	subsegment->m_fault = n_fault;
+	return true;
+}
+
+bool FXRayTraceStore::remove_segment(const FString &n_trace_id, FXRaySegment &n_segment)
+{
+	shard &s = shard_for(n_trace_id);
+
+	FScopeLock lock(&s.m_lock);
+	return s.m_segments.RemoveAndCopyValue(n_trace_id, n_segment);
+}
@@ -0,0 +1,67 @@
+/* (c) 2021 by Mackevision Mackevision Medien Design GmbH
+ * Licensed under the Apache License, Version 2.0.
+ * See attached file LICENSE for full details
+ */
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+
+/*!
+ * A subsegment as recorded, turned into JSON only when its segment ends
+ */
+struct FXRaySubsegment
+{
+	uint64   m_id = 0;
+	FString  m_name;
+	double   m_start_time = 0.0;   //!< seconds since epoch
+	double   m_end_time = 0.0;     //!< 0 while in progress
+	bool     m_fault = false;
+};
+
+/*!
+ * A segment in progress and its subsegments
+ */
+struct FXRaySegment
+{
+	uint64   m_id = 0;
+	FString  m_name;
+	FString  m_trace_id;
+	double   m_start_time = 0.0;   //!< seconds since epoch
+	double   m_end_time = 0.0;     //!< set when the segment ends
+	bool     m_fault = false;
+	TArray<FXRaySubsegment> m_subsegments;
+};
+
+/*!
+ * Segments in progress by trace ID.
+ * Traces are spread over shards by the hash of their ID, each with its own lock,
+ * so concurrent jobs rarely wait for each other.
+ */
+class FXRayTraceStore
+{
+	public:
+		/// Replaces a segment of the same trace in progress
+		void add_segment(FXRaySegment &&n_segment);
+
+		/// false if there is no segment in progress for this trace
+		bool add_subsegment(const FString &n_trace_id, FXRaySubsegment &&n_subsegment);
+
+		/// false if there is no such subsegment in progress
+		bool end_subsegment(const FString &n_trace_id, const uint64 n_subsegment_id, const double n_end_time, const bool n_fault);
+
+		/// Take the segment out of the store. false if there is none for this trace
+		bool remove_segment(const FString &n_trace_id, FXRaySegment &n_segment);
+
+	private:
+		static constexpr int32 s_shard_count = 32;
+
+		struct alignas(PLATFORM_CACHE_LINE_SIZE) shard {
+			FCriticalSection              m_lock;
+			TMap<FString, FXRaySegment>   m_segments;
+		};
+
+		shard &shard_for(const FString &n_trace_id);
+
+		shard    m_shards[s_shard_count];
+};
@@ -9,6 +9,32 @@
 
 #include "AWSConnectionConfig.generated.h"
 
+/**
+ * How X-Ray segments are sent
+ */
+UENUM()
+enum class EXRayTransport : uint8
+{
+	/** PutTraceSegments calls to the X-Ray API, in batches */
+	Api,
+
+	/** UDP datagrams to a local X-Ray daemon */
+	Daemon
+};
+
+/**
+ * Which log lines to drop when the CloudWatch log buffer is full
+ */
+UENUM()
+enum class ECloudWatchLogOverflow : uint8
+{
+	/** The oldest lines make room for new ones */
+	DropOldest,
+
+	/** Lines less severe than warnings are dropped once the buffer is 3/4 full */
+	DropBelowWarning
+};
+
 /**
  * Placing this Actor in your persistent Level activates usage of the MVAWS
  * system and allow for configuration of basic parameters.
@@ -58,6 +84,51 @@ class MVAWS_API AAWSConnectionConfig : public AActor
 		 */
 		UPROPERTY(EditAnywhere, Category = "MVAWS|CloudWatch")
 		FString CloudWatchLogGroupPrefix = TEXT("/mv/render-group/");
+
+		/**
+		 * @brief Memory in megabytes log lines may occupy while waiting to be sent
+		 * to CloudWatch. It is allocated once when logging starts. If CloudWatch can't
+		 * be reached for a while and this runs full, lines are dropped as
+		 * CloudWatchLogOverflow says. Dropped lines are counted and reported.
+		 */
+		UPROPERTY(EditAnywhere, Category = "MVAWS|CloudWatch", Meta = (ClampMin = "1", ClampMax = "1024"))
+		int CloudWatchLogBufferMB = 16;
+
+		/**
+		 * @brief Which lines to drop when the CloudWatch log buffer is full.
+		 */
+		UPROPERTY(EditAnywhere, Category = "MVAWS|CloudWatch")
+		ECloudWatchLogOverflow CloudWatchLogOverflow = ECloudWatchLogOverflow::DropOldest;
+
+		/**
+		 * @brief Write log lines to local disk before sending them to CloudWatch.
+		 * Lines are sent from there, and only what was sent is removed. So logs of a
+		 * crashed process or logs that couldn't be sent while CloudWatch was unreachable
+		 * are sent later on, at the latest after the next start.
+		 */
+		UPROPERTY(EditAnywhere, Category = "MVAWS|CloudWatch")
+		bool CloudWatchLogSpool = false;
+
+		/**
+		 * @brief Directory for the CloudWatch log spool. Defaults to Saved/MVAWS/LogSpool
+		 * of the project. Each engine process needs a directory of its own.
+		 */
+		UPROPERTY(EditAnywhere, Category = "MVAWS|CloudWatch")
+		FString CloudWatchLogSpoolDirectory;
+
+		/**
+		 * @brief The spool is split into files of this size in megabytes.
+		 * Files are deleted once all their lines were sent.
+		 */
+		UPROPERTY(EditAnywhere, Category = "MVAWS|CloudWatch", Meta = (ClampMin = "1", ClampMax = "1024"))
+		int CloudWatchLogSpoolSegmentMB = 16;
+
+		/**
+		 * @brief How many megabytes the spool may occupy on disk. When exceeded, the oldest
+		 * unsent lines are deleted.
+		 */
+		UPROPERTY(EditAnywhere, Category = "MVAWS|CloudWatch", Meta = (ClampMin = "1"))
+		int CloudWatchLogSpoolMaxMB = 1024;
 		
 		/**
 		 * @brief Set to true to enable CloudWatch metrics.
@@ -85,6 +156,175 @@ class MVAWS_API AAWSConnectionConfig : public AActor
 		UPROPERTY(EditAnywhere, Category = "MVAWS|S3")
 		FString BucketName;
 
+		/**
+		 * @brief Uploads larger than this (in megabytes) are split into parts and
+		 * sent as S3 multipart upload with several parts in flight at once.
+		 * Smaller uploads go out with a single PutObject call.
+		 */
+		UPROPERTY(EditAnywhere, Category = "MVAWS|S3", Meta = (ClampMin = "5"))
+		int MultipartThresholdMB = 16;
+
+		/**
+		 * @brief Size of each part in a multipart upload in megabytes.
+		 * S3 requires at least 5 MB for all but the last part. The size is raised
+		 * automatically if an upload would otherwise exceed 10000 parts.
+		 */
+		UPROPERTY(EditAnywhere, Category = "MVAWS|S3", Meta = (ClampMin = "5", ClampMax = "1024"))
+		int MultipartPartSizeMB = 8;
+
+		/**
+		 * @brief How many parts of a single multipart upload may be sent concurrently.
+		 */
+		UPROPERTY(EditAnywhere, Category = "MVAWS|S3", Meta = (ClampMin = "1", ClampMax = "32"))
+		int MultipartConcurrency = 4;
+
+		/**
+		 * @brief How often a single failed part is re-sent before the whole
+		 * multipart upload is aborted and reported as failed.
+		 */
+		UPROPERTY(EditAnywhere, Category = "MVAWS|S3", Meta = (ClampMin = "0", ClampMax = "10"))
+		int MultipartPartRetries = 3;
+
+		/**
+		 * @brief How many uploads run at the same time. Each one occupies a thread
+		 * of MVAWS' own upload pool. Further uploads are queued.
+		 */
+		UPROPERTY(EditAnywhere, Category = "MVAWS|S3", Meta = (ClampMin = "1", ClampMax = "64"))
+		int MaxConcurrentUploads = 8;
+
+		/**
+		 * @brief How many megabytes of memory buffers queued and running uploads may
+		 * hold together. When exhausted, cache_upload() refuses new buffers and hands
+		 * them back to the caller until running uploads have finished.
+		 */
+		UPROPERTY(EditAnywhere, Category = "MVAWS|S3", Meta = (ClampMin = "16"))
+		int UploadMemoryBudgetMB = 1024;
+
+		/**
+		 * @brief How often a failed upload is tried again before the completion handler
+		 * reports failure. Only throttling, server errors, timeouts and broken connections
+		 * are retried. Memory buffers are held until the last attempt.
+		 */
+		UPROPERTY(EditAnywhere, Category = "MVAWS|S3", Meta = (ClampMin = "0", ClampMax = "10"))
+		int S3UploadRetries = 3;
+
+		/**
+		 * @brief Backoff before the first retry of an upload or part in milliseconds, at most.
+		 * Doubles with each retry, the actual wait is random between zero and that.
+		 */
+		UPROPERTY(EditAnywhere, Category = "MVAWS|S3", Meta = (ClampMin = "10"))
+		int S3RetryBaseDelayMs = 200;
+
+		/**
+		 * @brief Longest backoff before a retry in milliseconds.
+		 */
+		UPROPERTY(EditAnywhere, Category = "MVAWS|S3", Meta = (ClampMin = "100"))
+		int S3RetryMaxDelayMs = 10000;
+
+		/**
+		 * @brief Retries of all uploads together may not exceed this percentage of
+		 * requests, plus a few to get lone uploads through. Keeps retries from making
+		 * S3 throttling worse.
+		 */
+		UPROPERTY(EditAnywhere, Category = "MVAWS|S3", Meta = (ClampMin = "0", ClampMax = "100"))
+		int S3RetryBudgetPercent = 10;
+
+		/**
+		 * @brief Record multipart uploads of files on local disk, so that a failed upload
+		 * continues with the parts that are missing instead of starting over. This also
+		 * works after a restart, when the same file is uploaded to the same object again.
+		 * Failed uploads are left open in S3 for that, until they're resumed or expire.
+		 */
+		UPROPERTY(EditAnywhere, Category = "MVAWS|S3")
+		bool S3ResumableUploads = false;
+
+		/**
+		 * @brief Directory for the upload records. Defaults to Saved/MVAWS/UploadJournal
+		 * of the project.
+		 */
+		UPROPERTY(EditAnywhere, Category = "MVAWS|S3")
+		FString S3UploadJournalDirectory;
+
+		/**
+		 * @brief Recorded uploads older than this many hours are aborted in S3 instead of
+		 * resumed, so their parts don't linger. Checked for all records when the plugin starts.
+		 */
+		UPROPERTY(EditAnywhere, Category = "MVAWS|S3", Meta = (ClampMin = "1"))
+		int S3AbortIncompleteUploadsAfterHours = 24;
+
+		/**
+		 * @brief Downloads are fetched in byte ranges of this many megabytes,
+		 * several at once, so that large objects come over more than one connection.
+		 */
+		UPROPERTY(EditAnywhere, Category = "MVAWS|S3", Meta = (ClampMin = "1", ClampMax = "1024"))
+		int S3DownloadPartSizeMB = 8;
+
+		/**
+		 * @brief How many ranges of a single download may be fetched concurrently.
+		 */
+		UPROPERTY(EditAnywhere, Category = "MVAWS|S3", Meta = (ClampMin = "1", ClampMax = "32"))
+		int S3DownloadConcurrency = 8;
+
+		/**
+		 * @brief Directory of the local S3 object cache used by cached_download().
+		 * Defaults to Saved/MVAWS/ObjectCache of the project. Only one process may use it at a time.
+		 */
+		UPROPERTY(EditAnywhere, Category = "MVAWS|S3")
+		FString S3CacheDirectory;
+
+		/**
+		 * @brief Size cap of the object cache in megabytes. Least recently used objects
+		 * are evicted beyond it, except those still held by the caller.
+		 */
+		UPROPERTY(EditAnywhere, Category = "MVAWS|S3", Meta = (ClampMin = "1"))
+		int S3CacheSizeMB = 10240;
+
+		/**
+		 * @brief Cached objects confirmed current by S3 less than this many seconds ago
+		 * are served without asking again. 0 checks the ETag with every request.
+		 */
+		UPROPERTY(EditAnywhere, Category = "MVAWS|S3", Meta = (ClampMin = "0"))
+		int S3CacheRevalidateSeconds = 0;
+
+		/**
+		 * @brief Maximum number of connections the S3 client keeps open.
+		 * Concurrent uploads and multipart parts beyond this wait for a free connection.
+		 */
+		UPROPERTY(EditAnywhere, Category = "MVAWS|S3", Meta = (ClampMin = "1", ClampMax = "256"))
+		int S3MaxConnections = 25;
+
+		/**
+		 * @brief Timeout for establishing a connection to S3 in milliseconds.
+		 */
+		UPROPERTY(EditAnywhere, Category = "MVAWS|S3", Meta = (ClampMin = "100"))
+		int S3ConnectTimeoutMs = 1000;
+
+		/**
+		 * @brief How long an S3 connection may stall while sending or receiving (milliseconds).
+		 */
+		UPROPERTY(EditAnywhere, Category = "MVAWS|S3", Meta = (ClampMin = "1000"))
+		int S3RequestTimeoutMs = 10000;
+
+		/**
+		 * @brief Keep idle S3 connections alive with TCP keep-alive packets so they
+		 * can be reused between uploads.
+		 */
+		UPROPERTY(EditAnywhere, Category = "MVAWS|S3")
+		bool S3TcpKeepAlive = true;
+
+		/**
+		 * @brief Interval of TCP keep-alive packets in milliseconds.
+		 */
+		UPROPERTY(EditAnywhere, Category = "MVAWS|S3", Meta = (ClampMin = "15000"))
+		int S3TcpKeepAliveIntervalMs = 30000;
+
+		/**
+		 * @brief Number of connections to the default bucket opened during startup,
+		 * so the first uploads don't have to wait for TLS handshakes. 0 to disable.
+		 */
+		UPROPERTY(EditAnywhere, Category = "MVAWS|S3", Meta = (ClampMin = "0", ClampMax = "64"))
+		int S3PrewarmConnections = 4;
+
 		/**
 		 * @brief The name of the Environment Variable where the application tries to get the
 		 * SQS queue url from, overrides the value defined in the QueueURL property
@@ -124,6 +364,27 @@ class MVAWS_API AAWSConnectionConfig : public AActor
 		UPROPERTY(EditAnywhere, Category = "MVAWS|SQS")
 		bool SQSHandlerOnGameThread = true;
 
+		/**
+		 * @brief How many messages to receive with each call to SQS (1-10).
+		 * With more than one, the surplus waits in a local buffer and is handed to the
+		 * handler as soon as the previous message is done, without another round trip to SQS.
+		 * Buffered messages are kept invisible to other consumers while they wait and are
+		 * released back into the queue when polling stops.
+		 * Leave at 1 when several nodes share a queue with few, long running jobs.
+		 */
+		UPROPERTY(EditAnywhere, Category = "MVAWS|SQS", Meta = (ClampMin = "1", ClampMax = "10"))
+		int SQSPrefetchMessages = 1;
+
+		/**
+		 * @brief Keep messages invisible to other consumers for as long as the handler
+		 * works on them. Shortly before a message's visibility timeout runs out, it is
+		 * extended by the queue's visibility timeout again until the promise is set.
+		 * Use this if jobs may take longer than the queue's visibility timeout, so they
+		 * don't get processed twice. Calling set_message_visibilty_timeout() is not necessary then.
+		 */
+		UPROPERTY(EditAnywhere, Category = "MVAWS|SQS")
+		bool SQSVisibilityHeartbeat = false;
+
 		/**
 		 * @brief enable XRay tracing
 		 * Be aware, this requires the plugin to be able to reach an XRay endpoint.
@@ -134,6 +395,16 @@ class MVAWS_API AAWSConnectionConfig : public AActor
 		UPROPERTY(EditAnywhere, Category = "MVAWS|XRay")
 		bool XRayEnabled = false;
 
+		/**
+		 * @brief How to send X-Ray segments.
+		 * Daemon sends them via UDP to an X-Ray daemon at the address in the environment
+		 * variable AWS_XRAY_DAEMON_ADDRESS, or 127.0.0.1:2000 if not set. The daemon
+		 * forwards them to X-Ray, so this works from isolated subnets as long as the daemon
+		 * can reach X-Ray. Falls back to Api if the address cannot be resolved.
+		 */
+		UPROPERTY(EditAnywhere, Category = "MVAWS|XRay")
+		EXRayTransport XRayTransport = EXRayTransport::Api;
+
 	private:
 		/*!
 		* A UBillboardComponent to hold AWS icon sprite
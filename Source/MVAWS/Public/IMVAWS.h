@@ -9,6 +9,7 @@
 #include "Modules/ModuleManager.h"
 #include "Templates/UniquePtr.h"
 #include "Templates/SharedPointer.h"
+#include "Misc/Timespan.h"
 
 DECLARE_LOG_CATEGORY_EXTERN(LogMVAWS, Log, All);
 
@@ -33,7 +34,8 @@ struct FMVAWSMessage {
 	uint32  m_message_age;
 
 	/**
-	 * is set when contained in the message response.
+	 * is set when contained in the message response. When it isn't and X-Ray
+	 * is enabled, this is a new root trace id.
 	 * This can be used as trace_id for start_trace_segment() and related functions 
 	 * to measure steps along the way of this message being processed
 	 */
@@ -78,6 +80,55 @@ struct FS3UploadTarget {
 	FString ContentType = TEXT("image/jpg");
 };
 
+/**
+ * S3 download source info
+ */
+struct FS3DownloadSource {
+
+	/**
+	 * The bucket to download from
+	 * If not set, will default to the Config Actor's settings.
+	 */
+	FString BucketName;
+
+	/**
+	 * Full object key including suffix
+	 */
+	FString ObjectKey;
+};
+
+/// Content of a downloaded object
+using FS3DownloadBuffer = TSharedPtr<TArray64<uint8>, ESPMode::ThreadSafe>;
+
+/// First parameter is success, second is name of object, third is the content. Null on failure
+DECLARE_DELEGATE_ThreeParams(FOnCacheDownloadFinished, bool, FString, FS3DownloadBuffer);
+
+/// First parameter is success, second is name of object
+DECLARE_DELEGATE_TwoParams(FOnCacheDownloadToFileFinished, bool, FString);
+
+/**
+ * An object from the local S3 object cache, mapped into memory read-only.
+ * The file stays mapped and in the cache for as long as this is held.
+ */
+class FS3CachedObject {
+
+	public:
+		virtual ~FS3CachedObject() = default;
+
+		/// Content of the object. Null if it is empty
+		virtual const uint8 *data() const noexcept = 0;
+
+		virtual int64 size() const noexcept = 0;
+
+		/// The file in the cache holding the content, for APIs that want a path. Must not be modified
+		virtual const FString &file_path() const noexcept = 0;
+};
+
+using FS3CachedObjectPtr = TSharedPtr<FS3CachedObject, ESPMode::ThreadSafe>;
+
+/// First parameter is success, second is name of object, third is the cached object. Null on failure
+DECLARE_DELEGATE_ThreeParams(FOnCachedDownloadFinished, bool, FString, FS3CachedObjectPtr);
+
 class MVAWS_API IMVAWSModule : public IModuleInterface 
 {
 	public:
@@ -100,12 +151,27 @@ class MVAWS_API IMVAWSModule : public IModuleInterface
 		* \param n_completion an optional delegate which will execute on the game thread when upload is complete.
 		*		The delegate will not fire when the function returned false. Leave empty if not needed.
 		*		If the S3 upload is the last call in a chain, you can use this to finalize the X-Ray trace
-		* \return true when operation was successfully started. Doesn't mean it finished. See n_completion for this
+		* \return true when operation was successfully started. Doesn't mean it finished. See n_completion for this.
+		*		Also returns false when the buffers of queued and running uploads exceed the configured
+		*		memory budget (backpressure). In this case n_data is left untouched and still owned
+		*		by the caller, who may try again later or use cache_upload_blocking()
 		*/
 		virtual bool cache_upload(const FS3UploadTarget &n_target, TUniquePtr<unsigned char[]> &&n_data,
 				const size_t n_size, const FString &n_trace_id = FString{},
 				const FOnCacheUploadFinished n_completion = FOnCacheUploadFinished{}) = 0;
 
+		/*!
+		* Same as cache_upload() for memory buffers but when the upload memory budget is exhausted,
+		* blocks the calling thread until enough buffers were released or n_max_wait has passed.
+		* Don't call this on the game thread unless you can afford the stall.
+		*
+		* \param n_max_wait how long to wait for budget at most
+		* \return false if budget wasn't available in time. n_data then is still owned by the caller
+		*/
+		virtual bool cache_upload_blocking(const FS3UploadTarget &n_target, TUniquePtr<unsigned char[]> &&n_data,
+				const size_t n_size, const FTimespan &n_max_wait, const FString &n_trace_id = FString{},
+				const FOnCacheUploadFinished n_completion = FOnCacheUploadFinished{}) = 0;
+
 		/*!
 		* Upload the file to the configured AWS bucket.
 		* Each upload, when complete, will cause OnCacheUploadFinished delegate to fire
@@ -121,6 +187,49 @@ class MVAWS_API IMVAWSModule : public IModuleInterface
 		*/
 		virtual bool cache_upload(const FS3UploadTarget &n_target, const FString &n_file_path,
 			const FString &n_trace_id = FString{}, const FOnCacheUploadFinished n_completion = FOnCacheUploadFinished{}) = 0;
+
+		/*!
+		* Download an object into memory. The buffer is allocated for the whole object up front.
+		* Large objects are fetched in byte ranges over several connections at once,
+		* each range written right where it belongs in the buffer.
+		*
+		* \param n_source where to download from
+		* \param n_completion executes on the game thread when the download is complete,
+		*		with the object's content if it succeeded
+		* \param n_trace_id if set, call will be measured as a X-Ray subsegment. Must be opened before
+		* \return true when operation was successfully started. Doesn't mean it finished. See n_completion for this
+		*/
+		virtual bool cache_download(const FS3DownloadSource &n_source, const FOnCacheDownloadFinished n_completion,
+			const FString &n_trace_id = FString{}) = 0;
+
+		/*!
+		* Download an object into a file. Same as above, with ranges written at their offset
+		* into a file of the object's size. That file is next to n_file_path and renamed to it
+		* when complete, so n_file_path never holds part of an object.
+		*
+		* \param n_source where to download from
+		* \param n_file_path absolute path of the file to write. Replaced if it exists
+		* \param n_trace_id if set, call will be measured as a X-Ray subsegment. Must be opened before
+		* \param n_completion an optional delegate which will execute on the game thread when download is complete.
+		* \return true when operation was successfully started. Doesn't mean it finished. See n_completion for this
+		*/
+		virtual bool cache_download(const FS3DownloadSource &n_source, const FString &n_file_path,
+			const FString &n_trace_id = FString{}, const FOnCacheDownloadToFileFinished n_completion = FOnCacheDownloadToFileFinished{}) = 0;
+
+		/*!
+		* Get an object through the local object cache. If it is cached, S3 is only asked
+		* whether the ETag is still current. Otherwise, or if it changed, it is downloaded
+		* like above into the cache, evicting the least recently used objects beyond the size cap.
+		* Either way the object is handed out as the cache file mapped into memory.
+		*
+		* \param n_source where to download from
+		* \param n_completion executes on the game thread when the object is ready,
+		*		with the mapped object if it succeeded
+		* \param n_trace_id if set, call will be measured as a X-Ray subsegment. Must be opened before
+		* \return true when operation was successfully started. Doesn't mean it finished. See n_completion for this
+		*/
+		virtual bool cached_download(const FS3DownloadSource &n_source, const FOnCachedDownloadFinished n_completion,
+			const FString &n_trace_id = FString{}) = 0;
 		
 		/** @defgroup SQS functions
 		 * @{
@@ -135,8 +244,11 @@ class MVAWS_API IMVAWSModule : public IModuleInterface
 		 * If set to true, the message will be deleted from the Q. If set to false, not.
 		 * Either way, once the promise is set, polling continues.
 		 * 
+		 * @param n_max_in_flight How many messages may be handed to the delegate before their
+		 * promises are set. With more than 1 the delegate gets the next message while others are
+		 * still being worked on and each promise completes independently. Must handle that.
 		 */
-		virtual bool start_sqs_poll(FOnSQSMessageReceived &&n_delegate) = 0;
+		virtual bool start_sqs_poll(FOnSQSMessageReceived &&n_delegate, const int n_max_in_flight = 1) = 0;
 
 		/// Stop polling. Blocks until thread s joined.
 		virtual void stop_sqs_poll() = 0;
@@ -148,6 +260,13 @@ class MVAWS_API IMVAWSModule : public IModuleInterface
 		 * @{
 		 */
 
+		/*!
+		* start a new trace. Use this when work didn't come with a trace id,
+		* for example an SQS message without AWSTraceHeader
+		* \return the new trace id to use with start_trace_segment(). Empty if X-Ray is disabled
+		*/
+		virtual FString new_trace_id() = 0;
+
 		/*!
 		* start a new logical segment as part of a trace
 		* \param n_trace_id assuming you already have a trace id given,
@@ -201,12 +320,43 @@ class MVAWS_API IMVAWSModule : public IModuleInterface
 		 *  will return immediately and queue for sending with the next batch
 		 */
 		virtual void count_file_upload(const float n_milliseconds) noexcept = 0;
+
+		/*! \brief register one S3 download, to memory or file
+		 *  will return immediately and queue for sending with the next batch
+		 */
+		virtual void count_download(const float n_milliseconds) noexcept = 0;
 		
 		/*! \brief register one received SQS message
 		 *  will return immediately and queue for sending with the next batch
 		 */
 		virtual void count_sqs_message() noexcept = 0;
 
+		/*! \brief register one SQS message whose promise was set
+		 *  \param n_handler_milliseconds from handing the message to the delegate until the promise was set
+		 *  \param n_receive_to_ack_milliseconds from receiving the message until the promise was set
+		 */
+		virtual void count_sqs_message_handled(const float n_handler_milliseconds, const float n_receive_to_ack_milliseconds) noexcept = 0;
+
+		/*! \brief register one upload of X-Ray segments
+		 *  will return immediately and queue for sending with the next batch
+		 */
+		virtual void count_xray_flush(const float n_milliseconds) noexcept = 0;
+
+		/*! \brief register log lines the CloudWatch log buffer had to drop
+		 *  will return immediately and queue for sending with the next batch
+		 */
+		virtual void count_log_lines_dropped(const uint32 n_lines) noexcept = 0;
+
+		/*! \brief register a retry of an S3 upload or part
+		 *  \param n_allowed false if the retry budget didn't allow it
+		 */
+		virtual void count_s3_retry(const bool n_allowed) noexcept = 0;
+
+		/*! \brief register a request to the S3 object cache
+		 *  \param n_hit true if it was served from the cache
+		 */
+		virtual void count_s3_cache(const bool n_hit) noexcept = 0;
+
 		//! @}
 
 		/*!